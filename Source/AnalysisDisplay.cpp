@@ -0,0 +1,228 @@
+#include "AnalysisDisplay.h"
+
+//==============================================================================
+AnalysisDisplay::AnalysisDisplay (AnalogSaturationAudioProcessor& p)
+    : audioProcessor (p),
+      frames (static_cast<size_t>(fftSize)),
+      vBlankAttachment (this, [this] { refresh(); })
+{
+    spectrum.fill (minimumDecibels);
+    audioProcessor.getAnalysisFifo().setActive (true);
+}
+
+AnalysisDisplay::~AnalysisDisplay()
+{
+    audioProcessor.getAnalysisFifo().setActive (false);
+}
+
+//==============================================================================
+void AnalysisDisplay::refresh()
+{
+    const double now = juce::Time::getMillisecondCounterHiRes() * 0.001;
+    const double elapsed = lastRefreshSeconds > 0.0 ? now - lastRefreshSeconds : 0.0;
+    lastRefreshSeconds = now;
+
+    auto& fifo = audioProcessor.getAnalysisFifo();
+    float inputPeak = 0.0f;
+    float outputPeak = 0.0f;
+    bool receivedFrames = false;
+
+    for (;;)
+    {
+        const int numFrames = fifo.read (frames.data(), static_cast<int>(frames.size()));
+
+        if (numFrames == 0)
+            break;
+
+        analyse (frames.data(), numFrames, inputPeak, outputPeak);
+        receivedFrames = true;
+    }
+
+    // Peak meters with a constant release in decibels
+    const auto release = static_cast<float>(elapsed) * meterReleasePerSecond;
+    const float newInputLevel = juce::jmax (juce::Decibels::gainToDecibels (inputPeak, minimumDecibels),
+                                            inputLevel - release);
+    const float newOutputLevel = juce::jmax (juce::Decibels::gainToDecibels (outputPeak, minimumDecibels),
+                                             outputLevel - release);
+
+    const bool levelsChanged = newInputLevel != inputLevel || newOutputLevel != outputLevel;
+    inputLevel = newInputLevel;
+    outputLevel = newOutputLevel;
+
+    if (receivedFrames || levelsChanged)
+        repaint();
+}
+
+void AnalysisDisplay::analyse (const AnalysisFifo::Frame* newFrames, int numFrames, float& inputPeak, float& outputPeak)
+{
+    // Output sample n answers input sample n - latency
+    const int latency = juce::jlimit (0, maxAlignmentDelay - 1, audioProcessor.getLatencySamples());
+
+    for (int i = 0; i < numFrames; ++i)
+    {
+        const auto& frame = newFrames[i];
+
+        inputPeak = juce::jmax (inputPeak, std::abs (frame.input));
+        outputPeak = juce::jmax (outputPeak, std::abs (frame.output));
+
+        inputDelay[static_cast<size_t>(delayPosition)] = frame.input;
+        const float alignedInput = inputDelay[static_cast<size_t>((delayPosition - latency + maxAlignmentDelay) % maxAlignmentDelay)];
+        delayPosition = (delayPosition + 1) % maxAlignmentDelay;
+
+        if (++decimationCounter >= curveDecimation)
+        {
+            decimationCounter = 0;
+            curvePoints[static_cast<size_t>(curvePosition)] = { alignedInput, frame.output };
+            curvePosition = (curvePosition + 1) % numCurvePoints;
+            numCurvePointsStored = juce::jmin (numCurvePointsStored + 1, numCurvePoints);
+        }
+
+        outputHistory[static_cast<size_t>(historyPosition)] = frame.output;
+        historyPosition = (historyPosition + 1) % fftSize;
+
+        if (++samplesSinceTransform >= fftHop)
+        {
+            samplesSinceTransform = 0;
+            transformSpectrum();
+        }
+    }
+}
+
+void AnalysisDisplay::transformSpectrum()
+{
+    // Oldest sample first
+    for (int i = 0; i < fftSize; ++i)
+        fftData[static_cast<size_t>(i)] = outputHistory[static_cast<size_t>((historyPosition + i) % fftSize)];
+
+    std::fill (fftData.begin() + fftSize, fftData.end(), 0.0f);
+
+    window.multiplyWithWindowingTable (fftData.data(), static_cast<size_t>(fftSize));
+    fft.performFrequencyOnlyForwardTransform (fftData.data());
+
+    // A full-scale sine reads 0 dB: the Hann window halves the amplitude
+    const float scale = 4.0f / static_cast<float>(fftSize);
+
+    for (size_t bin = 0; bin < spectrum.size(); ++bin)
+    {
+        const float level = juce::Decibels::gainToDecibels (fftData[bin] * scale, minimumDecibels);
+
+        // Rise at once, fall gently
+        spectrum[bin] = juce::jmax (level, spectrum[bin] - 3.0f);
+    }
+}
+
+//==============================================================================
+void AnalysisDisplay::paint (juce::Graphics& g)
+{
+    g.setColour (juce::Colours::black.withAlpha (0.3f));
+    g.fillRoundedRectangle (meterArea.toFloat(), 4.0f);
+    g.fillRoundedRectangle (spectrumArea.toFloat(), 4.0f);
+    g.fillRoundedRectangle (curveArea.toFloat(), 4.0f);
+
+    paintMeters (g);
+    paintSpectrum (g);
+    paintTransferCurve (g);
+}
+
+void AnalysisDisplay::paintMeters (juce::Graphics& g) const
+{
+    auto area = meterArea.reduced (6);
+    auto labels = area.removeFromBottom (16);
+    const int barWidth = area.getWidth() / 2;
+
+    auto paintBar = [&g] (juce::Rectangle<int> bar, float level)
+    {
+        const float proportion = juce::jlimit (0.0f, 1.0f, 1.0f - level / minimumDecibels);
+        auto filled = bar.toFloat().reduced (3.0f, 0.0f);
+        filled = filled.removeFromBottom (filled.getHeight() * proportion);
+
+        g.setColour (level > -1.0f ? juce::Colours::orangered : juce::Colours::limegreen);
+        g.fillRect (filled);
+    };
+
+    paintBar (area.removeFromLeft (barWidth), inputLevel);
+    paintBar (area, outputLevel);
+
+    g.setColour (juce::Colours::lightgrey);
+    g.setFont (12.0f);
+    g.drawText ("In", labels.removeFromLeft (barWidth), juce::Justification::centred);
+    g.drawText ("Out", labels, juce::Justification::centred);
+}
+
+void AnalysisDisplay::paintSpectrum (juce::Graphics& g) const
+{
+    const auto area = spectrumArea.reduced (4).toFloat();
+    const double sampleRate = audioProcessor.getSampleRate() > 0.0 ? audioProcessor.getSampleRate() : 44100.0;
+    const double minimumFrequency = 20.0;
+    const double maximumFrequency = sampleRate * 0.5;
+
+    // Decade grid lines at 100 Hz, 1 kHz and 10 kHz
+    g.setColour (juce::Colours::white.withAlpha (0.1f));
+
+    for (double frequency = 100.0; frequency < maximumFrequency; frequency *= 10.0)
+    {
+        const auto x = area.getX() + area.getWidth()
+                                     * static_cast<float>(std::log (frequency / minimumFrequency)
+                                                          / std::log (maximumFrequency / minimumFrequency));
+        g.drawVerticalLine (juce::roundToInt (x), area.getY(), area.getBottom());
+    }
+
+    juce::Path path;
+    const int numPoints = juce::jmax (2, juce::roundToInt (area.getWidth()));
+
+    for (int i = 0; i < numPoints; ++i)
+    {
+        const double position = static_cast<double>(i) / (numPoints - 1);
+        const double frequency = minimumFrequency * std::pow (maximumFrequency / minimumFrequency, position);
+        const auto bin = juce::jlimit (0, static_cast<int>(spectrum.size()) - 1,
+                                       juce::roundToInt (frequency / sampleRate * fftSize));
+
+        const float x = area.getX() + static_cast<float>(position) * area.getWidth();
+        const float y = juce::jmap (spectrum[static_cast<size_t>(bin)], minimumDecibels, 0.0f,
+                                    area.getBottom(), area.getY());
+
+        if (i == 0)
+            path.startNewSubPath (x, y);
+        else
+            path.lineTo (x, y);
+    }
+
+    g.setColour (juce::Colours::skyblue);
+    g.strokePath (path, juce::PathStrokeType (1.5f));
+}
+
+void AnalysisDisplay::paintTransferCurve (juce::Graphics& g) const
+{
+    const auto area = curveArea.reduced (4).toFloat();
+    const auto centre = area.getCentre();
+
+    // Axes and the unity line
+    g.setColour (juce::Colours::white.withAlpha (0.1f));
+    g.drawHorizontalLine (juce::roundToInt (centre.y), area.getX(), area.getRight());
+    g.drawVerticalLine (juce::roundToInt (centre.x), area.getY(), area.getBottom());
+    g.drawLine (area.getX(), area.getBottom(), area.getRight(), area.getY());
+
+    g.setColour (juce::Colours::orange);
+
+    for (int i = 0; i < numCurvePointsStored; ++i)
+    {
+        const auto& point = curvePoints[static_cast<size_t>(i)];
+        const float x = centre.x + juce::jlimit (-1.0f, 1.0f, point.x) * area.getWidth() * 0.5f;
+        const float y = centre.y - juce::jlimit (-1.0f, 1.0f, point.y) * area.getHeight() * 0.5f;
+
+        g.fillRect (x - 1.0f, y - 1.0f, 2.0f, 2.0f);
+    }
+}
+
+void AnalysisDisplay::resized()
+{
+    auto area = getLocalBounds();
+
+    meterArea = area.removeFromLeft (60);
+    area.removeFromLeft (10);
+
+    curveArea = area.removeFromRight (area.getHeight());
+    area.removeFromRight (10);
+
+    spectrumArea = area;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include <array>
+#include <vector>
+
+/**
+ * Live analysis for the editor: input and output level meters, the output
+ * spectrum and the transfer curve (output against input).
+ *
+ * Frames arrive through the processor's AnalysisFifo. Everything here runs
+ * on the message thread, paced by the display's vertical blank: each
+ * refresh drains the FIFO, updates the meters, decimates the frames into
+ * the transfer curve and, once enough new output has arrived, computes a
+ * windowed FFT. It repaints only when something new arrived.
+ *
+ * The input is delayed by the plugin latency before being paired with the
+ * output, so the transfer curve stays aligned when oversampling is on.
+ */
+class AnalysisDisplay  : public juce::Component
+{
+public:
+    explicit AnalysisDisplay (AnalogSaturationAudioProcessor&);
+    ~AnalysisDisplay() override;
+
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+private:
+    AnalogSaturationAudioProcessor& audioProcessor;
+
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int fftHop = fftSize / 2;
+
+    static constexpr int maxAlignmentDelay = 4096;
+    static constexpr int numCurvePoints = 512;
+    static constexpr int curveDecimation = 8;
+
+    static constexpr float minimumDecibels = -96.0f;
+    static constexpr float meterReleasePerSecond = 24.0f;
+
+    // Frames drained from the FIFO on each refresh
+    std::vector<AnalysisFifo::Frame> frames;
+
+    // Levels
+    float inputLevel = minimumDecibels;
+    float outputLevel = minimumDecibels;
+    double lastRefreshSeconds = 0.0;
+
+    // Spectrum of the most recent fftSize output samples
+    juce::dsp::FFT fft { fftOrder };
+    juce::dsp::WindowingFunction<float> window { static_cast<size_t>(fftSize),
+                                                 juce::dsp::WindowingFunction<float>::hann, false };
+    std::array<float, fftSize> outputHistory {};
+    int historyPosition = 0;
+    int samplesSinceTransform = 0;
+    std::array<float, 2 * fftSize> fftData {};
+    std::array<float, fftSize / 2> spectrum {};
+
+    // Input delay line for latency alignment, and the recent (input, output) pairs
+    std::array<float, maxAlignmentDelay> inputDelay {};
+    int delayPosition = 0;
+    int decimationCounter = 0;
+    std::array<juce::Point<float>, numCurvePoints> curvePoints {};
+    int curvePosition = 0;
+    int numCurvePointsStored = 0;
+
+    juce::Rectangle<int> meterArea, spectrumArea, curveArea;
+
+    juce::VBlankAttachment vBlankAttachment;
+
+    void refresh();
+    void analyse (const AnalysisFifo::Frame* newFrames, int numFrames, float& inputPeak, float& outputPeak);
+    void transformSpectrum();
+
+    void paintMeters (juce::Graphics&) const;
+    void paintSpectrum (juce::Graphics&) const;
+    void paintTransferCurve (juce::Graphics&) const;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalysisDisplay)
+};
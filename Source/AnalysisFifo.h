@@ -0,0 +1,113 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+/**
+ * Single-producer, single-consumer channel carrying the plugin's input and
+ * output from the audio thread to the editor.
+ *
+ * Each frame holds the mono downmix of one input sample and the matching
+ * output sample. The audio thread reserves room for a block before
+ * processing, writes the input into it, and publishes the block with the
+ * output once processing is done, so no scratch copy of the input is
+ * needed. Storage is allocated once in the constructor; when the reader
+ * falls behind, frames that do not fit are dropped rather than waited for.
+ *
+ * Nothing is recorded until a reader calls setActive(true).
+ */
+class AnalysisFifo
+{
+public:
+    struct Frame
+    {
+        float input = 0.0f;
+        float output = 0.0f;
+    };
+
+    explicit AnalysisFifo(int capacity = 1 << 15)
+        : fifo(capacity),
+          frames(static_cast<size_t>(capacity))
+    {
+    }
+
+    // Called from the editor as it opens and closes
+    void setActive(bool shouldBeActive) { active.store(shouldBeActive); }
+    bool isActive() const { return active.load(); }
+
+    //==============================================================================
+    // Audio thread: reserve room for the block and record its input
+    template <typename SampleType>
+    void beginBlock(const juce::AudioBuffer<SampleType>& buffer)
+    {
+        numReserved = 0;
+
+        if (! active.load(std::memory_order_relaxed))
+            return;
+
+        const int numSamples = juce::jmin(buffer.getNumSamples(), fifo.getFreeSpace());
+        fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+        numReserved = size1 + size2;
+
+        downmix(buffer, 0, start1, size1, &Frame::input);
+        downmix(buffer, size1, start2, size2, &Frame::input);
+    }
+
+    // Audio thread: add the processed output and publish the block
+    template <typename SampleType>
+    void endBlock(const juce::AudioBuffer<SampleType>& buffer)
+    {
+        if (numReserved == 0)
+            return;
+
+        downmix(buffer, 0, start1, size1, &Frame::output);
+        downmix(buffer, size1, start2, size2, &Frame::output);
+        fifo.finishedWrite(numReserved);
+        numReserved = 0;
+    }
+
+    //==============================================================================
+    // Reader: copy out up to maxFrames of the oldest frames, returns the count
+    int read(Frame* destination, int maxFrames)
+    {
+        int readStart1, readSize1, readStart2, readSize2;
+        fifo.prepareToRead(maxFrames, readStart1, readSize1, readStart2, readSize2);
+
+        std::copy_n(frames.data() + readStart1, readSize1, destination);
+        std::copy_n(frames.data() + readStart2, readSize2, destination + readSize1);
+
+        fifo.finishedRead(readSize1 + readSize2);
+        return readSize1 + readSize2;
+    }
+
+private:
+    juce::AbstractFifo fifo;
+    std::vector<Frame> frames;
+    std::atomic<bool> active { false };
+
+    // The region reserved by beginBlock(), audio thread only
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+    int numReserved = 0;
+
+    template <typename SampleType>
+    void downmix(const juce::AudioBuffer<SampleType>& buffer, int offset, int start, int size, float Frame::* field)
+    {
+        if (size <= 0)
+            return;
+
+        const int numChannels = buffer.getNumChannels();
+        const float scale = numChannels > 0 ? 1.0f / static_cast<float>(numChannels) : 0.0f;
+
+        for (int i = 0; i < size; ++i)
+            frames[static_cast<size_t>(start + i)].*field = 0.0f;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const auto* samples = buffer.getReadPointer(channel, offset);
+
+            for (int i = 0; i < size; ++i)
+                frames[static_cast<size_t>(start + i)].*field += static_cast<float>(samples[i]) * scale;
+        }
+    }
+};
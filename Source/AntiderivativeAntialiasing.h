@@ -0,0 +1,432 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LaneMath.h"
+#include <cmath>
+#include <vector>
+
+/**
+ * Antiderivative anti-aliasing (ADAA) for memoryless nonlinearities.
+ *
+ * First-order ADAA replaces f(x[n]) with the mean of f over the segment
+ * [x[n-1], x[n]], computed from the first antiderivative F1. Second-order
+ * ADAA does the same with F2 over the last three inputs. Both suppress
+ * aliasing far below the plain waveshaper without oversampling, at the cost
+ * of a half- or one-sample delay.
+ */
+enum class AntialiasingMode
+{
+    Off,
+    FirstOrder,
+    SecondOrder
+};
+
+/**
+ * A nonlinearity tabulated together with its first and second antiderivatives
+ * (both zero at x = 0). The antiderivatives are integrated once at build time
+ * with Gauss-Legendre quadrature and read back with cubic Hermite
+ * interpolation, using the exact lower-order function as the slope. Outside
+ * the table the function is continued linearly and the antiderivatives are
+ * extended in closed form.
+ *
+ * The same table doubles as a lookup table for the nonlinearity itself. Each
+ * node stores f, f', F1 and F2 together, so an interpolation touches a single
+ * pair of adjacent nodes. The worst-case interpolation error of f inside the
+ * table range is measured against the exact function at build time.
+ *
+ * Every lookup also comes in a lane version, which works out the cell and
+ * fraction and blends the nodes in SIMD; only the node reads are per lane.
+ */
+class AntiderivativeTable
+{
+public:
+    using Lanes = LaneMath::Lanes;
+
+    template <typename Function>
+    AntiderivativeTable(Function&& function, double range, int pointsPerUnit)
+        : range(range),
+          step(1.0 / pointsPerUnit),
+          invStep(static_cast<double>(pointsPerUnit))
+    {
+        const int numCells = 2 * static_cast<int>(std::ceil(range * pointsPerUnit));
+        const int numPoints = numCells + 1;
+        const int centre = numCells / 2;
+        this->range = centre * step;
+
+        nodes.resize(static_cast<size_t>(numPoints));
+
+        const double derivativeDelta = step * 1.0e-3;
+
+        for (int i = 0; i < numPoints; ++i)
+        {
+            const double x = (i - centre) * step;
+            auto& node = nodes[static_cast<size_t>(i)];
+            node.value = function(x);
+            node.slope = (function(x + derivativeDelta) - function(x - derivativeDelta))
+                       / (2.0 * derivativeDelta);
+        }
+
+        // Three-point Gauss-Legendre rule on each cell [a, b]
+        const double abscissae[3] = { -std::sqrt(0.6), 0.0, std::sqrt(0.6) };
+        const double weights[3] = { 5.0 / 9.0, 8.0 / 9.0, 5.0 / 9.0 };
+
+        auto integrateCell = [&](double a, double& integral, double& weightedFromA)
+        {
+            integral = 0.0;
+            weightedFromA = 0.0;
+
+            for (int k = 0; k < 3; ++k)
+            {
+                const double s = a + 0.5 * step * (1.0 + abscissae[k]);
+                const double fs = function(s) * weights[k] * 0.5 * step;
+                integral += fs;
+                weightedFromA += (s - a) * fs;
+            }
+        };
+
+        nodes[static_cast<size_t>(centre)].first = 0.0;
+        nodes[static_cast<size_t>(centre)].second = 0.0;
+
+        // Integrate outwards from zero in both directions
+        for (int i = centre; i < numCells; ++i)
+        {
+            double integral, weightedFromA;
+            integrateCell((i - centre) * step, integral, weightedFromA);
+
+            const auto& a = nodes[static_cast<size_t>(i)];
+            auto& b = nodes[static_cast<size_t>(i + 1)];
+            b.first = a.first + integral;
+            b.second = a.second + step * a.first + (step * integral - weightedFromA);
+        }
+
+        for (int i = centre; i > 0; --i)
+        {
+            double integral, weightedFromA;
+            integrateCell((i - 1 - centre) * step, integral, weightedFromA);
+
+            const auto& b = nodes[static_cast<size_t>(i)];
+            auto& a = nodes[static_cast<size_t>(i - 1)];
+            a.first = b.first - integral;
+            a.second = b.second - step * b.first + weightedFromA;
+        }
+
+        // Hermite error peaks inside each cell; sample it at the quarter points
+        for (int i = 0; i < numCells; ++i)
+        {
+            for (double t : { 0.25, 0.5, 0.75 })
+            {
+                const double x = (i - centre + t) * step;
+                maxError = juce::jmax(maxError, std::abs(this->function(x) - function(x)));
+            }
+        }
+    }
+
+    double function(double x) const
+    {
+        if (x > range)
+            return nodes.back().value + nodes.back().slope * (x - range);
+        if (x < -range)
+            return nodes.front().value + nodes.front().slope * (x + range);
+
+        return interpolate<&Node::value, &Node::slope>(x);
+    }
+
+    // Slope of the interpolated function, e.g. for Newton iterations
+    double derivative(double x) const
+    {
+        if (x > range)
+            return nodes.back().slope;
+        if (x < -range)
+            return nodes.front().slope;
+
+        const double position = (x + range) * invStep;
+        const int index = juce::jlimit(0, static_cast<int>(nodes.size()) - 2, static_cast<int>(position));
+        const double t = position - index;
+
+        const auto& n0 = nodes[static_cast<size_t>(index)];
+        const auto& n1 = nodes[static_cast<size_t>(index + 1)];
+
+        const double t2 = t * t;
+
+        return (6.0 * t2 - 6.0 * t) * invStep * (n0.value - n1.value)
+             + (3.0 * t2 - 4.0 * t + 1.0) * n0.slope
+             + (3.0 * t2 - 2.0 * t) * n1.slope;
+    }
+
+    double firstAntiderivative(double x) const
+    {
+        if (x > range)
+        {
+            const auto& edge = nodes.back();
+            const double d = x - range;
+            return edge.first + d * (edge.value + d * 0.5 * edge.slope);
+        }
+        if (x < -range)
+        {
+            const auto& edge = nodes.front();
+            const double d = x + range;
+            return edge.first + d * (edge.value + d * 0.5 * edge.slope);
+        }
+
+        return interpolate<&Node::first, &Node::value>(x);
+    }
+
+    double secondAntiderivative(double x) const
+    {
+        if (x > range)
+        {
+            const auto& edge = nodes.back();
+            const double d = x - range;
+            return edge.second + d * (edge.first + d * (edge.value * 0.5 + d * edge.slope / 6.0));
+        }
+        if (x < -range)
+        {
+            const auto& edge = nodes.front();
+            const double d = x + range;
+            return edge.second + d * (edge.first + d * (edge.value * 0.5 + d * edge.slope / 6.0));
+        }
+
+        return interpolate<&Node::second, &Node::first>(x);
+    }
+
+    Lanes function(Lanes x) const
+    {
+        auto outside = [&x](const Node& edge, double edgeX)
+        {
+            return (x - edgeX) * edge.slope + edge.value;
+        };
+
+        return extend(x, interpolate<&Node::value, &Node::slope>(x), outside);
+    }
+
+    Lanes firstAntiderivative(Lanes x) const
+    {
+        auto outside = [&x](const Node& edge, double edgeX)
+        {
+            const Lanes d = x - edgeX;
+            return d * (d * (0.5 * edge.slope) + edge.value) + edge.first;
+        };
+
+        return extend(x, interpolate<&Node::first, &Node::value>(x), outside);
+    }
+
+    Lanes secondAntiderivative(Lanes x) const
+    {
+        auto outside = [&x](const Node& edge, double edgeX)
+        {
+            const Lanes d = x - edgeX;
+            return d * (d * (d * (edge.slope / 6.0) + edge.value * 0.5) + edge.first) + edge.second;
+        };
+
+        return extend(x, interpolate<&Node::second, &Node::first>(x), outside);
+    }
+
+    // Worst-case absolute error of function() inside the table range
+    double getMaxError() const { return maxError; }
+
+private:
+    struct Node
+    {
+        double value;   // f
+        double slope;   // f'
+        double first;   // F1
+        double second;  // F2
+    };
+
+    double range;
+    double step;
+    double invStep;
+    double maxError = 0.0;
+
+    std::vector<Node> nodes;
+
+    // Cubic Hermite interpolation of one node field using another as its derivative
+    template <double Node::*y, double Node::*dy>
+    double interpolate(double x) const
+    {
+        const double position = (x + range) * invStep;
+        const int last = static_cast<int>(nodes.size()) - 2;
+        const int index = juce::jlimit(0, last, static_cast<int>(position));
+        const double t = position - index;
+
+        const auto& n0 = nodes[static_cast<size_t>(index)];
+        const auto& n1 = nodes[static_cast<size_t>(index + 1)];
+
+        const double t2 = t * t;
+        const double t3 = t2 * t;
+
+        return (2.0 * t3 - 3.0 * t2 + 1.0) * (n0.*y)
+             + (t3 - 2.0 * t2 + t) * step * (n0.*dy)
+             + (3.0 * t2 - 2.0 * t3) * (n1.*y)
+             + (t3 - t2) * step * (n1.*dy);
+    }
+
+    // The same for every lane. Positions are clamped so that lanes outside
+    // the table still read a valid pair of nodes; extend() replaces them.
+    template <double Node::*y, double Node::*dy>
+    Lanes interpolate(Lanes x) const
+    {
+        const double last = static_cast<double>(nodes.size() - 2);
+        const Lanes position = LaneMath::clamp((x + range) * invStep, 0.0, last + 1.0);
+        const Lanes index = Lanes::min(Lanes::truncate(position), Lanes::expand(last));
+        const Lanes t = position - index;
+
+        alignas(sizeof(Lanes)) double indices[Lanes::SIZE];
+        alignas(sizeof(Lanes)) double y0[Lanes::SIZE];
+        alignas(sizeof(Lanes)) double dy0[Lanes::SIZE];
+        alignas(sizeof(Lanes)) double y1[Lanes::SIZE];
+        alignas(sizeof(Lanes)) double dy1[Lanes::SIZE];
+        index.copyToRawArray(indices);
+
+        // Gather the two nodes of every lane's cell
+        for (size_t lane = 0; lane < Lanes::SIZE; ++lane)
+        {
+            const auto* cell = nodes.data() + static_cast<int>(indices[lane]);
+            const auto& n0 = cell[0];
+            const auto& n1 = cell[1];
+            y0[lane] = n0.*y;
+            dy0[lane] = n0.*dy;
+            y1[lane] = n1.*y;
+            dy1[lane] = n1.*dy;
+        }
+
+        const Lanes t2 = t * t;
+        const Lanes t3 = t2 * t;
+
+        return (t3 * 2.0 - t2 * 3.0 + 1.0) * Lanes::fromRawArray(y0)
+             + (t3 - t2 * 2.0 + t) * (Lanes::fromRawArray(dy0) * step)
+             + (t2 * 3.0 - t3 * 2.0) * Lanes::fromRawArray(y1)
+             + (t3 - t2) * (Lanes::fromRawArray(dy1) * step);
+    }
+
+    // Interpolated lanes inside the table, the edge continuations outside it;
+    // outside(edge, edgeX) continues the curve from an edge node
+    template <typename Outside>
+    Lanes extend(Lanes x, Lanes inside, Outside&& outside) const
+    {
+        const auto above = Lanes::greaterThan(x, Lanes::expand(range));
+        const auto below = Lanes::lessThan(x, Lanes::expand(-range));
+
+        if (! LaneMath::anyLane(above | below))
+            return inside;
+
+        return LaneMath::select(above, outside(nodes.back(), range),
+                                LaneMath::select(below, outside(nodes.front(), -range), inside));
+    }
+};
+
+/**
+ * Per-channel ADAA history, one lane per channel.
+ */
+struct AntialiasingState
+{
+    using Lanes = LaneMath::Lanes;
+
+    Lanes x1 = Lanes::expand(0.0);     // Previous input
+    Lanes x2 = Lanes::expand(0.0);     // Input before that
+    Lanes d1 = Lanes::expand(0.0);     // Second-order divided difference of (x1, x2)
+
+    void reset()
+    {
+        x1 = Lanes::expand(0.0);
+        x2 = Lanes::expand(0.0);
+        d1 = Lanes::expand(0.0);
+    }
+};
+
+namespace ADAA
+{
+    // Below this input step the divided differences are ill-conditioned and
+    // the midpoint fallbacks are used instead
+    static constexpr double tolerance = 1.0e-5;
+
+    /**
+     * Apply a nonlinearity with the given anti-aliasing order to every lane.
+     * Shaper provides value(x), first(x) and second(x) on lanes: f, F1 and F2.
+     *
+     * The divided differences are taken in all lanes at once. Lanes whose
+     * input step is below the tolerance are swapped for the midpoint
+     * fallback with a mask; the fallback is only evaluated when some lane
+     * needs it.
+     */
+    template <AntialiasingMode mode, typename Shaper>
+    forcedinline LaneMath::Lanes process(LaneMath::Lanes input, AntialiasingState& state, const Shaper& shaper)
+    {
+        using Lanes = LaneMath::Lanes;
+        
+        if constexpr (mode == AntialiasingMode::Off)
+        {
+            juce::ignoreUnused(state);
+            return shaper.value(input);
+        }
+        else if constexpr (mode == AntialiasingMode::FirstOrder)
+        {
+            const Lanes x0 = input;
+            const Lanes x1 = state.x1;
+            const Lanes delta = x0 - x1;
+            const auto illConditioned = Lanes::lessThan(Lanes::abs(delta), Lanes::expand(tolerance));
+            
+            Lanes output = LaneMath::divide(shaper.first(x0) - shaper.first(x1),
+                                            LaneMath::select(illConditioned, Lanes::expand(1.0), delta));
+            
+            if (LaneMath::anyLane(illConditioned))
+                output = LaneMath::select(illConditioned, shaper.value((x0 + x1) * 0.5), output);
+            
+            state.x1 = x0;
+            return output;
+        }
+        else
+        {
+            const Lanes x0 = input;
+            const Lanes x1 = state.x1;
+            const Lanes x2 = state.x2;
+            const Lanes one = Lanes::expand(1.0);
+            const Lanes limit = Lanes::expand(tolerance);
+            
+            // Divided difference of F2 over (x0, x1)
+            const Lanes delta01 = x0 - x1;
+            const auto illConditioned01 = Lanes::lessThan(Lanes::abs(delta01), limit);
+            const Lanes second1 = shaper.second(x1);
+            
+            Lanes d0 = LaneMath::divide(shaper.second(x0) - second1,
+                                        LaneMath::select(illConditioned01, one, delta01));
+            
+            if (LaneMath::anyLane(illConditioned01))
+                d0 = LaneMath::select(illConditioned01, shaper.first((x0 + x1) * 0.5), d0);
+            
+            const Lanes delta02 = x0 - x2;
+            const auto illConditioned02 = Lanes::lessThan(Lanes::abs(delta02), limit);
+            
+            Lanes y = LaneMath::divide((d0 - state.d1) * 2.0,
+                                       LaneMath::select(illConditioned02, one, delta02));
+            
+            if (LaneMath::anyLane(illConditioned02))
+            {
+                // Fall back to the segment from x1 to the mean of x0 and x2,
+                // or to its midpoint when that is short too
+                const Lanes xBar = (x0 + x2) * 0.5;
+                const Lanes deltaBar = xBar - x1;
+                const auto illConditionedBar = Lanes::lessThan(Lanes::abs(deltaBar), limit);
+                const auto useSegment = illConditioned02 & ~illConditionedBar;
+                const auto useMidpoint = illConditioned02 & illConditionedBar;
+                
+                if (LaneMath::anyLane(useSegment))
+                {
+                    const Lanes safeDeltaBar = LaneMath::select(illConditionedBar, one, deltaBar);
+                    const Lanes yBar = LaneMath::divide((shaper.first(xBar)
+                                                         + LaneMath::divide(second1 - shaper.second(xBar), safeDeltaBar)) * 2.0,
+                                                        safeDeltaBar);
+                    y = LaneMath::select(useSegment, yBar, y);
+                }
+                
+                if (LaneMath::anyLane(useMidpoint))
+                    y = LaneMath::select(useMidpoint, shaper.value((xBar + x1) * 0.5), y);
+            }
+            
+            state.x2 = x1;
+            state.x1 = x0;
+            state.d1 = d0;
+            return y;
+        }
+    }
+}
@@ -1,72 +1,198 @@
 #include "CircuitModels.h"
 
+using CircuitType = NonlinearStateSpace::CircuitType;
+
+const std::array<std::array<CircuitModels::Kernel, CircuitModels::numCircuitTypes>, CircuitModels::numModelTypes>
+    CircuitModels::kernels {{
+        { &processKernel<ModelType::WDFBased, CircuitType::TubeTriode>,
+          &processKernel<ModelType::WDFBased, CircuitType::TransistorBJT>,
+          &processKernel<ModelType::WDFBased, CircuitType::DiodeClipper>,
+          &processKernel<ModelType::WDFBased, CircuitType::OpAmpSaturation> },
+        { &processKernel<ModelType::StateSpace, CircuitType::TubeTriode>,
+          &processKernel<ModelType::StateSpace, CircuitType::TransistorBJT>,
+          &processKernel<ModelType::StateSpace, CircuitType::DiodeClipper>,
+          &processKernel<ModelType::StateSpace, CircuitType::OpAmpSaturation> },
+        { &processKernel<ModelType::Hybrid, CircuitType::TubeTriode>,
+          &processKernel<ModelType::Hybrid, CircuitType::TransistorBJT>,
+          &processKernel<ModelType::Hybrid, CircuitType::DiodeClipper>,
+          &processKernel<ModelType::Hybrid, CircuitType::OpAmpSaturation> }
+    }};
+
 CircuitModels::CircuitModels()
 {
 }
 
-void CircuitModels::prepare(double sampleRate)
+void CircuitModels::prepare(double sampleRate, int maximumBlockSize)
+{
+    wetBuffer.assign(static_cast<size_t>(juce::jmax(1, maximumBlockSize)), Lanes::expand(0.0));
+    hybridBuffer.assign(wetBuffer.size(), Lanes::expand(0.0));
+    fadeBuffer.assign(wetBuffer.size(), Lanes::expand(0.0));
+    setSampleRate(sampleRate);
+    
+    // Off the audio thread, so both voices can start with their solution
+    // tables in place
+    for (auto& voice : voices)
+        voice.stateSpace.prepare(sampleRate);
+}
+
+void CircuitModels::setSampleRate(double sampleRate)
 {
-    wdf.prepare(sampleRate);
-    stateSpace.prepare(sampleRate);
+    this->sampleRate = sampleRate;
+    
+    startVoice(voices[static_cast<size_t>(activeVoice)]);
+    activeKernel = getSelectedKernel();
+    crossfadeRemaining = 0;
+    crossfadeLength = juce::jmax(1, juce::roundToInt(sampleRate * crossfadeTimeSeconds));
+    
+    updateSubModelParameters();
+    for (auto& voice : voices)
+    {
+        voice.wdf.prepare(sampleRate);
+        voice.stateSpace.restart(sampleRate);
+    }
+    
+    toneSmoothed.reset(sampleRate, rampTimeSeconds);
+    toneSmoothed.setCurrentAndTargetValue(tone);
+    mixSmoothed.reset(sampleRate, rampTimeSeconds);
+    mixSmoothed.setCurrentAndTargetValue(mix);
+    
+    toneState = Lanes::expand(0.0);
 }
 
 void CircuitModels::reset()
 {
-    wdf.reset();
-    stateSpace.reset();
-    drySample = 0.0f;
+    for (auto& voice : voices)
+    {
+        voice.wdf.reset();
+        voice.stateSpace.reset();
+    }
+    
+    // Nothing to fade from after a reset
+    startVoice(voices[static_cast<size_t>(activeVoice)]);
+    activeKernel = getSelectedKernel();
+    crossfadeRemaining = 0;
+    toneState = Lanes::expand(0.0);
 }
 
-float CircuitModels::processSample(float input)
+void CircuitModels::processBlock(const Lanes* input, Lanes* output, int numSamples)
 {
-    drySample = input;
+    // Sub-model setters are cheap and idempotent, so they run once per block
+    // rather than once per sample
+    updateSubModelParameters();
     
-    float output = 0.0f;
+    const int chunkSize = static_cast<int>(wetBuffer.size());
     
-    switch (modelType)
+    for (int offset = 0; offset < numSamples; offset += chunkSize)
     {
-        case ModelType::WDFBased:
-        {
-            wdf.setNonlinearity(drive);
-            output = wdf.processSample(input);
-            break;
-        }
-        case ModelType::StateSpace:
+        processChunk(input + offset, output + offset, juce::jmin(chunkSize, numSamples - offset));
+    }
+}
+
+void CircuitModels::processChunk(const Lanes* input, Lanes* output, int numSamples)
+{
+    Lanes* wet = wetBuffer.data();
+    
+    // A new model or circuit starts on the idle voice; the old kernel keeps
+    // running on its own voice until the crossfade completes. Changes made
+    // during a fade are picked up once it finishes.
+    const Kernel selectedKernel = getSelectedKernel();
+    
+    if (selectedKernel != activeKernel && crossfadeRemaining == 0)
+    {
+        fadingKernel = activeKernel;
+        activeVoice = 1 - activeVoice;
+        activeKernel = selectedKernel;
+        crossfadeRemaining = crossfadeLength;
+        
+        // Restarting the idle voice snaps its smoothed parameters and clears
+        // its state; it neither allocates nor locks, and the state-space
+        // model only requests its new solution table
+        auto& voice = voices[static_cast<size_t>(activeVoice)];
+        startVoice(voice);
+        updateSubModelParameters();
+        voice.wdf.prepare(sampleRate);
+        voice.stateSpace.restart(sampleRate);
+    }
+    
+    activeKernel(voices[static_cast<size_t>(activeVoice)], input, wet, hybridBuffer.data(), numSamples);
+    
+    if (crossfadeRemaining > 0)
+    {
+        Lanes* faded = fadeBuffer.data();
+        fadingKernel(voices[static_cast<size_t>(1 - activeVoice)], input, faded, hybridBuffer.data(), numSamples);
+        
+        const double step = 1.0 / crossfadeLength;
+        
+        for (int i = 0; i < numSamples; ++i)
         {
-            stateSpace.setDrive(drive);
-            stateSpace.setTone(tone);
-            stateSpace.setCircuitType(static_cast<NonlinearStateSpace::CircuitType>(circuitType));
-            output = stateSpace.processSample(input);
-            break;
+            const double fadeOut = juce::jmax(0, crossfadeRemaining - i) * step;
+            wet[i] = wet[i] * (1.0 - fadeOut) + faded[i] * fadeOut;
         }
-        case ModelType::Hybrid:
+        
+        crossfadeRemaining = juce::jmax(0, crossfadeRemaining - numSamples);
+    }
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        // Apply tone control (simple EQ)
+        double toneAlpha = toneSmoothed.getNextValue();
+        toneState = wet[i] * toneAlpha + toneState * (1.0 - toneAlpha);
+        Lanes out = wet[i] * (1.0 - toneAlpha * 0.2) + toneState * (toneAlpha * 0.2);
+        
+        // Mix dry/wet
+        double wetMix = mixSmoothed.getNextValue();
+        output[i] = input[i] * (1.0 - wetMix) + out * wetMix;
+    }
+}
+
+template <CircuitModels::ModelType model, CircuitType circuit>
+void CircuitModels::processKernel(Voice& voice, const Lanes* input, Lanes* output, Lanes* scratch,
+                                  int numSamples)
+{
+    if constexpr (model == ModelType::WDFBased)
+    {
+        juce::ignoreUnused(scratch);
+        voice.wdf.processBlock(input, output, numSamples);
+    }
+    else if constexpr (model == ModelType::StateSpace)
+    {
+        juce::ignoreUnused(scratch);
+        voice.stateSpace.processBlock<circuit>(input, output, numSamples);
+    }
+    else
+    {
+        // Process through both and blend
+        voice.wdf.processBlock(input, output, numSamples);
+        voice.stateSpace.processBlock<circuit>(input, scratch, numSamples);
+        
+        for (int i = 0; i < numSamples; ++i)
         {
-            // Process through both and blend
-            wdf.setNonlinearity(drive);
-            float wdfOut = wdf.processSample(input);
-            
-            stateSpace.setDrive(drive * 0.7);
-            stateSpace.setTone(tone);
-            stateSpace.setCircuitType(static_cast<NonlinearStateSpace::CircuitType>(circuitType));
-            float ssOut = stateSpace.processSample(input);
-            
-            // Blend WDF and state-space outputs
-            output = wdfOut * 0.6f + ssOut * 0.4f;
-            break;
+            output[i] = output[i] * 0.6 + scratch[i] * 0.4;
         }
     }
-    
-    // Apply tone control (simple EQ)
-    static float toneState = 0.0f;
-    float toneAlpha = static_cast<float>(tone);
-    toneState = toneAlpha * output + (1.0f - toneAlpha) * toneState;
-    output = output * (1.0f - toneAlpha * 0.2f) + toneState * (toneAlpha * 0.2f);
-    
-    // Mix dry/wet
-    float wetMix = static_cast<float>(mix);
-    output = drySample * (1.0f - wetMix) + output * wetMix;
-    
-    return output;
+}
+
+CircuitModels::Kernel CircuitModels::getSelectedKernel() const
+{
+    return kernels[static_cast<size_t>(modelType)][static_cast<size_t>(circuitType)];
+}
+
+void CircuitModels::startVoice(Voice& voice)
+{
+    // The circuit type is fixed for the lifetime of a kernel, so it is only
+    // handed to a voice as that voice starts
+    voice.modelType = modelType;
+    voice.stateSpace.setCircuitType(static_cast<CircuitType>(circuitType));
+}
+
+void CircuitModels::updateSubModelParameters()
+{
+    for (auto& voice : voices)
+    {
+        voice.wdf.setNonlinearity(drive);
+        voice.stateSpace.setDrive(voice.modelType == ModelType::Hybrid ? drive * 0.7 : drive);
+        voice.stateSpace.setTone(tone);
+    }
 }
 
 void CircuitModels::setModelType(ModelType type)
@@ -82,11 +208,31 @@ void CircuitModels::setDrive(double drive)
 void CircuitModels::setTone(double tone)
 {
     this->tone = juce::jlimit(0.0, 1.0, tone);
+    toneSmoothed.setTargetValue(this->tone);
 }
 
 void CircuitModels::setMix(double mix)
 {
     this->mix = juce::jlimit(0.0, 1.0, mix);
+    mixSmoothed.setTargetValue(this->mix);
+}
+
+void CircuitModels::setAntialiasingMode(AntialiasingMode mode)
+{
+    for (auto& voice : voices)
+    {
+        voice.wdf.setAntialiasingMode(mode);
+        voice.stateSpace.setAntialiasingMode(mode);
+    }
+}
+
+void CircuitModels::setUseLookupTables(bool shouldUseTables)
+{
+    for (auto& voice : voices)
+    {
+        voice.wdf.setUseLookupTables(shouldUseTables);
+        voice.stateSpace.setUseLookupTables(shouldUseTables);
+    }
 }
 
 void CircuitModels::setCircuitType(int type)
@@ -3,12 +3,24 @@
 #include <JuceHeader.h>
 #include "WaveDigitalFilter.h"
 #include "NonlinearStateSpace.h"
+#include <array>
+#include <vector>
 
 /**
  * CircuitModels combines WDF and state-space models to create
  * sophisticated analog saturation effects.
+ *
+ * Each SIMD lane carries one independent audio channel, so a single
+ * instance processes up to LaneMath::numLanes channels in one pass.
+ *
+ * All DSP state lives in the instance. Instances are cache-line aligned so
+ * models running on different audio threads never share a line.
+ *
+ * Every model/circuit combination is compiled as its own kernel and picked
+ * from a table once per block. Switching kernels crossfades from the old one,
+ * which keeps running on a second set of sub-models for the fade.
  */
-class CircuitModels
+class alignas(64) CircuitModels
 {
 public:
     enum class ModelType
@@ -19,33 +31,84 @@ public:
     };
     
     CircuitModels();
+    CircuitModels(CircuitModels&&) = default;
     ~CircuitModels() = default;
     
-    void prepare(double sampleRate);
+    void prepare(double sampleRate, int maximumBlockSize);
     void reset();
     
-    float processSample(float input);
+    // Change the processing rate without reallocating; resets all state
+    void setSampleRate(double sampleRate);
+    
+    using Lanes = LaneMath::Lanes;
+    
+    // Process a block of lane vectors. Parameters are pushed to the sub-models
+    // once per block and ramped per sample. Input and output may alias.
+    void processBlock(const Lanes* input, Lanes* output, int numSamples);
     
     void setModelType(ModelType type);
     void setDrive(double drive);
     void setTone(double tone);
     void setMix(double mix);
     void setCircuitType(int type);
+    void setAntialiasingMode(AntialiasingMode mode);
+    void setUseLookupTables(bool shouldUseTables);
     
 private:
+    double sampleRate = 44100.0;
     ModelType modelType = ModelType::Hybrid;
     
-    WaveDigitalFilter wdf;
-    NonlinearStateSpace stateSpace;
+    // One set of sub-models and the model type it is running
+    struct Voice
+    {
+        WaveDigitalFilter wdf;
+        NonlinearStateSpace stateSpace;
+        ModelType modelType = ModelType::Hybrid;
+    };
+    
+    // The active voice, and the one fading out after a kernel switch
+    std::array<Voice, 2> voices;
+    int activeVoice = 0;
+    
+    static constexpr int numModelTypes = 3;
+    static constexpr int numCircuitTypes = 4;
+    
+    // A model/circuit combination compiled into one block loop. scratch holds
+    // the state-space output while Hybrid blends it in.
+    using Kernel = void (*)(Voice& voice, const Lanes* input, Lanes* output, Lanes* scratch, int numSamples);
+    
+    template <ModelType model, NonlinearStateSpace::CircuitType circuit>
+    static void processKernel(Voice& voice, const Lanes* input, Lanes* output, Lanes* scratch, int numSamples);
+    
+    static const std::array<std::array<Kernel, numCircuitTypes>, numModelTypes> kernels;
+    
+    Kernel activeKernel = nullptr;
+    Kernel fadingKernel = nullptr;
+    
+    static constexpr double crossfadeTimeSeconds = 0.01;
+    int crossfadeLength = 1;
+    int crossfadeRemaining = 0;
     
     double drive = 1.0;
     double tone = 0.5;
     double mix = 1.0;
     int circuitType = 0;
     
-    // Dry/wet mixing
-    float drySample = 0.0f;
+    juce::SmoothedValue<double> toneSmoothed;
+    juce::SmoothedValue<double> mixSmoothed;
+    
+    static constexpr double rampTimeSeconds = 0.02;
+    
+    // Scratch buffers for sub-model output, sized in prepare()
+    std::vector<Lanes> wetBuffer;
+    std::vector<Lanes> hybridBuffer;
+    std::vector<Lanes> fadeBuffer;
     
     // Tone control state (per-instance)
-    float toneState = 0.0f;
+    Lanes toneState = Lanes::expand(0.0);
+    
+    Kernel getSelectedKernel() const;
+    void startVoice(Voice& voice);
+    void updateSubModelParameters();
+    void processChunk(const Lanes* input, Lanes* output, int numSamples);
 };
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Helpers for running several audio channels through the models at once,
+ * one channel per SIMD lane. Linear filtering maps directly onto
+ * juce::dsp::SIMDRegister arithmetic. Table lookups and branches are done in
+ * lanes too, with masks and select(); only the transcendental functions and
+ * the per-lane table reads fall back to scalar code.
+ */
+namespace LaneMath
+{
+    using Lanes = juce::dsp::SIMDRegister<double>;
+
+    using Mask = Lanes::vMaskType;
+
+    static constexpr int numLanes = static_cast<int>(Lanes::SIZE);
+
+    // Apply a scalar function to every lane. The lanes go through a raw
+    // array, as inserting them one at a time with set() stalls on the
+    // store-to-load forwarding of the whole register.
+    template <typename Function>
+    forcedinline Lanes applyLanewise(Lanes v, Function&& function)
+    {
+        alignas(sizeof(Lanes)) double values[Lanes::SIZE];
+        v.copyToRawArray(values);
+
+        for (size_t lane = 0; lane < Lanes::SIZE; ++lane)
+        {
+            values[lane] = function(values[lane]);
+        }
+
+        return Lanes::fromRawArray(values);
+    }
+
+    forcedinline Lanes clamp(Lanes v, double lower, double upper)
+    {
+        return Lanes::min(Lanes::max(v, Lanes::expand(lower)), Lanes::expand(upper));
+    }
+
+    // a where the mask is set, b elsewhere
+    forcedinline Lanes select(Mask mask, Lanes a, Lanes b)
+    {
+        return (a & mask) + (b & ~mask);
+    }
+
+    forcedinline bool anyLane(Mask mask)
+    {
+        for (size_t lane = 0; lane < Mask::SIZE; ++lane)
+        {
+            if (mask.get(lane) != 0)
+                return true;
+        }
+
+        return false;
+    }
+
+    forcedinline bool allLanes(Mask mask)
+    {
+        for (size_t lane = 0; lane < Mask::SIZE; ++lane)
+        {
+            if (mask.get(lane) == 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    // SIMDRegister has no division; the loop over a raw array vectorises
+    forcedinline Lanes divide(Lanes numerator, Lanes denominator)
+    {
+        alignas(sizeof(Lanes)) double n[Lanes::SIZE];
+        alignas(sizeof(Lanes)) double d[Lanes::SIZE];
+        numerator.copyToRawArray(n);
+        denominator.copyToRawArray(d);
+
+        for (size_t lane = 0; lane < Lanes::SIZE; ++lane)
+        {
+            n[lane] /= d[lane];
+        }
+
+        return Lanes::fromRawArray(n);
+    }
+
+    // Pack up to numLanes channels into lane vectors; unused lanes are zeroed
+    template <typename SampleType>
+    inline void interleave(const SampleType* const* channels, int numChannels,
+                           Lanes* destination, int numSamples)
+    {
+        alignas(sizeof(Lanes)) double frame[Lanes::SIZE] = {};
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                frame[channel] = static_cast<double>(channels[channel][i]);
+            }
+
+            destination[i] = Lanes::fromRawArray(frame);
+        }
+    }
+
+    // Unpack lane vectors back into up to numLanes channels
+    template <typename SampleType>
+    inline void deinterleave(const Lanes* source, SampleType* const* channels, int numChannels,
+                             int numSamples)
+    {
+        alignas(sizeof(Lanes)) double frame[Lanes::SIZE];
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            source[i].copyToRawArray(frame);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                channels[channel][i] = static_cast<SampleType>(frame[channel]);
+            }
+        }
+    }
+}
@@ -0,0 +1,414 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LaneMath.h"
+#include <array>
+#include <cmath>
+#include <utility>
+
+/**
+ * Nodal DK-method discretisation for circuits with one nonlinear port.
+ *
+ * A circuit is described as a small netlist of resistors, capacitors, one
+ * resistive voltage input and one nonlinear element, whose current i(v) is
+ * controlled by a node voltage v. Capacitors are discretised with the
+ * trapezoidal rule, and nodal analysis then yields the explicit system
+ *
+ *     p[n] = G x[n-1] + H u[n]
+ *     v[n] = p[n] + K i(v[n])
+ *     y[n] = D x[n-1] + E u[n] + F i(v[n])
+ *     x[n] = A x[n-1] + B u[n] + C i(v[n])
+ *
+ * (Yeh, Abel and Smith 2010; Holters and Zolzer 2011). The matrices are
+ * fixed-size and only need recomputing when a component value or the sample
+ * rate changes; while a component value ramps they can be stepped linearly
+ * between two solutions instead. The only implicit part is the scalar
+ * equation for v, solved by solve() or read from a SolutionTable.
+ */
+namespace DK
+{
+    template <int size>
+    using Vector = std::array<double, size>;
+
+    template <int rows, int cols>
+    using Matrix = std::array<std::array<double, cols>, rows>;
+
+    // Node 0 is ground; circuit nodes are numbered 1 to numNodes
+    template <int numNodes, int numStates>
+    class Netlist
+    {
+    public:
+        void addResistor(int p, int q, double R)
+        {
+            stamp(conductance, p, q, 1.0 / R);
+        }
+
+        // Capacitors become the states, in the order they are added
+        void addCapacitor(int p, int q, double C)
+        {
+            jassert (numCapacitors < numStates);
+
+            capacitors[static_cast<size_t>(numCapacitors++)] = { p, q, C };
+        }
+
+        // Input voltage u applied to a node through a series resistance
+        void setInput(int node, double R)
+        {
+            addResistor(node, 0, R);
+            inputInjection = {};
+            inject(inputInjection, node, 1.0 / R);
+        }
+
+        // Nonlinear current gain * i(v) injected into a node, with v the
+        // voltage of the control node
+        void setNonlinearity(int controlNode, int node, double gain)
+        {
+            nonlinearControl = controlNode;
+            nonlinearInjection = {};
+            inject(nonlinearInjection, node, gain);
+        }
+
+        void setOutput(int node, double gain)
+        {
+            outputNode = node;
+            outputGain = gain;
+        }
+
+    private:
+        template <int n, int s>
+        friend struct Matrices;
+
+        struct Capacitor
+        {
+            int p = 0;
+            int q = 0;
+            double C = 0.0;
+        };
+
+        Matrix<numNodes, numNodes> conductance {};
+        std::array<Capacitor, static_cast<size_t>(numStates)> capacitors {};
+        int numCapacitors = 0;
+
+        Vector<numNodes> inputInjection {};
+        Vector<numNodes> nonlinearInjection {};
+        int nonlinearControl = 0;
+        int outputNode = 0;
+        double outputGain = 1.0;
+
+        static void stamp(Matrix<numNodes, numNodes>& m, int p, int q, double g)
+        {
+            if (p > 0) m[static_cast<size_t>(p - 1)][static_cast<size_t>(p - 1)] += g;
+            if (q > 0) m[static_cast<size_t>(q - 1)][static_cast<size_t>(q - 1)] += g;
+
+            if (p > 0 && q > 0)
+            {
+                m[static_cast<size_t>(p - 1)][static_cast<size_t>(q - 1)] -= g;
+                m[static_cast<size_t>(q - 1)][static_cast<size_t>(p - 1)] -= g;
+            }
+        }
+
+        static void inject(Vector<numNodes>& v, int node, double value)
+        {
+            if (node > 0)
+                v[static_cast<size_t>(node - 1)] += value;
+        }
+
+        // Signed incidence of capacitor k at a node
+        double incidence(int k, int node) const
+        {
+            const auto& c = capacitors[static_cast<size_t>(k)];
+            return (c.p == node + 1 ? 1.0 : 0.0) - (c.q == node + 1 ? 1.0 : 0.0);
+        }
+    };
+
+    // Gauss-Jordan inverse for the small nodal matrices
+    template <int size>
+    inline Matrix<size, size> invert(Matrix<size, size> m)
+    {
+        Matrix<size, size> result {};
+
+        for (size_t i = 0; i < static_cast<size_t>(size); ++i)
+            result[i][i] = 1.0;
+
+        for (size_t col = 0; col < static_cast<size_t>(size); ++col)
+        {
+            size_t pivot = col;
+
+            for (size_t row = col + 1; row < static_cast<size_t>(size); ++row)
+                if (std::abs(m[row][col]) > std::abs(m[pivot][col]))
+                    pivot = row;
+
+            std::swap(m[col], m[pivot]);
+            std::swap(result[col], result[pivot]);
+
+            const double scale = 1.0 / m[col][col];
+
+            for (size_t k = 0; k < static_cast<size_t>(size); ++k)
+            {
+                m[col][k] *= scale;
+                result[col][k] *= scale;
+            }
+
+            for (size_t row = 0; row < static_cast<size_t>(size); ++row)
+            {
+                if (row == col)
+                    continue;
+
+                const double factor = m[row][col];
+
+                for (size_t k = 0; k < static_cast<size_t>(size); ++k)
+                {
+                    m[row][k] -= factor * m[col][k];
+                    result[row][k] -= factor * result[col][k];
+                }
+            }
+        }
+
+        return result;
+    }
+
+    template <int numNodes, int numStates>
+    struct Matrices
+    {
+        Matrix<numStates, numStates> A {};
+        Vector<numStates> B {}, C {}, D {}, G {};
+        double E = 0.0, F = 0.0, H = 0.0, K = 0.0;
+
+        void update(const Netlist<numNodes, numStates>& netlist, double sampleRate)
+        {
+            constexpr auto nodes = static_cast<size_t>(numNodes);
+            constexpr auto states = static_cast<size_t>(numStates);
+
+            // Trapezoidal companion conductances, stamped into the nodal matrix
+            Vector<numStates> companion {};
+            auto system = netlist.conductance;
+
+            for (size_t k = 0; k < states; ++k)
+            {
+                const auto& c = netlist.capacitors[k];
+                companion[k] = 2.0 * c.C * sampleRate;
+                Netlist<numNodes, numStates>::stamp(system, c.p, c.q, companion[k]);
+            }
+
+            const auto inverse = invert<numNodes>(system);
+
+            // Node voltages per unit state, input and nonlinear current
+            Matrix<numNodes, numStates> fromState {};
+            Vector<numNodes> fromInput {}, fromNonlinear {};
+
+            for (size_t n = 0; n < nodes; ++n)
+            {
+                for (size_t m = 0; m < nodes; ++m)
+                {
+                    for (size_t k = 0; k < states; ++k)
+                        fromState[n][k] += inverse[n][m] * netlist.incidence(static_cast<int>(k), static_cast<int>(m));
+
+                    fromInput[n] += inverse[n][m] * netlist.inputInjection[m];
+                    fromNonlinear[n] += inverse[n][m] * netlist.nonlinearInjection[m];
+                }
+            }
+
+            // State update: x[n] = 2 Gc v_c[n] - x[n-1]
+            for (size_t k = 0; k < states; ++k)
+            {
+                auto capacitorVoltage = [&](const auto& perNode)
+                {
+                    double v = 0.0;
+
+                    for (size_t n = 0; n < nodes; ++n)
+                        v += netlist.incidence(static_cast<int>(k), static_cast<int>(n)) * perNode(n);
+
+                    return 2.0 * companion[k] * v;
+                };
+
+                for (size_t j = 0; j < states; ++j)
+                    A[k][j] = capacitorVoltage([&](size_t n) { return fromState[n][j]; }) - (k == j ? 1.0 : 0.0);
+
+                B[k] = capacitorVoltage([&](size_t n) { return fromInput[n]; });
+                C[k] = capacitorVoltage([&](size_t n) { return fromNonlinear[n]; });
+            }
+
+            const auto output = static_cast<size_t>(netlist.outputNode - 1);
+            const auto control = static_cast<size_t>(netlist.nonlinearControl - 1);
+
+            for (size_t k = 0; k < states; ++k)
+            {
+                D[k] = netlist.outputGain * fromState[output][k];
+                G[k] = fromState[control][k];
+            }
+
+            E = netlist.outputGain * fromInput[output];
+            F = netlist.outputGain * fromNonlinear[output];
+            H = fromInput[control];
+            K = fromNonlinear[control];
+        }
+
+        // The per-sample increment that takes from to to in numSteps steps
+        static Matrices getStep(const Matrices& from, const Matrices& to, int numSteps)
+        {
+            const double scale = 1.0 / juce::jmax(1, numSteps);
+            Matrices step;
+            combine(step, to, from, [scale](double a, double b) { return (a - b) * scale; });
+            return step;
+        }
+
+        // Move every coefficient by one step from getStep()
+        void advance(const Matrices& step)
+        {
+            combine(*this, *this, step, [](double a, double b) { return a + b; });
+        }
+
+    private:
+        template <typename Function>
+        static void combine(Matrices& result, const Matrices& a, const Matrices& b, Function&& function)
+        {
+            for (size_t k = 0; k < static_cast<size_t>(numStates); ++k)
+            {
+                for (size_t j = 0; j < static_cast<size_t>(numStates); ++j)
+                    result.A[k][j] = function(a.A[k][j], b.A[k][j]);
+
+                result.B[k] = function(a.B[k], b.B[k]);
+                result.C[k] = function(a.C[k], b.C[k]);
+                result.D[k] = function(a.D[k], b.D[k]);
+                result.G[k] = function(a.G[k], b.G[k]);
+            }
+
+            result.E = function(a.E, b.E);
+            result.F = function(a.F, b.F);
+            result.H = function(a.H, b.H);
+            result.K = function(a.K, b.K);
+        }
+    };
+
+    // Newton-Raphson steps allowed per sample; bounds the worst-case cost
+    static constexpr int maxNewtonIterations = 4;
+    static constexpr double newtonTolerance = 1.0e-9;
+
+    /**
+     * Solve v = p + K f(v) from a warm-start guess. Shaper provides value(v)
+     * and derivative(v). With K <= 0 and f non-decreasing the residual is
+     * strictly monotonic, so the root is unique.
+     */
+    template <typename Shaper>
+    inline double solve(double p, double K, double guess, const Shaper& shaper,
+                        int maxIterations = maxNewtonIterations)
+    {
+        double v = guess;
+
+        for (int iteration = 0; iteration < maxIterations; ++iteration)
+        {
+            const double residual = p + K * shaper.value(v) - v;
+
+            if (std::abs(residual) < newtonTolerance)
+                break;
+
+            v += residual / (1.0 - K * shaper.derivative(v));
+        }
+
+        return v;
+    }
+
+    /**
+     * The root v(p) of the scalar equation, tabulated over p for a fixed K and
+     * nonlinearity and read back with cubic Hermite interpolation. Storage is
+     * fixed, so rebuilding never allocates.
+     */
+    class SolutionTable
+    {
+    public:
+        static constexpr double range = 16.0;
+        static constexpr int pointsPerUnit = 32;
+        static constexpr int numPoints = 2 * static_cast<int>(range) * pointsPerUnit + 1;
+
+        template <typename Shaper>
+        void build(double K, const Shaper& shaper)
+        {
+            double v = -range;
+
+            for (size_t i = 0; i < nodes.size(); ++i)
+            {
+                const double p = -range + static_cast<double>(i) / pointsPerUnit;
+
+                // Each node warm-starts from its neighbour; iterate to convergence
+                v = solve(p, K, v, shaper, 8 * maxNewtonIterations);
+
+                nodes[i] = { v, 1.0 / (1.0 - K * shaper.derivative(v)) };
+            }
+        }
+
+        bool covers(double p) const { return std::abs(p) < range; }
+        
+        // True if every lane is inside the table
+        bool covers(LaneMath::Lanes p) const
+        {
+            using Lanes = LaneMath::Lanes;
+            return LaneMath::allLanes(Lanes::lessThan(Lanes::abs(p), Lanes::expand(range)));
+        }
+
+        double operator()(double p) const
+        {
+            const double position = (p + range) * pointsPerUnit;
+            const int index = juce::jlimit(0, numPoints - 2, static_cast<int>(position));
+            const double t = position - index;
+            const double step = 1.0 / pointsPerUnit;
+
+            const auto& n0 = nodes[static_cast<size_t>(index)];
+            const auto& n1 = nodes[static_cast<size_t>(index + 1)];
+
+            const double t2 = t * t;
+            const double t3 = t2 * t;
+
+            return (2.0 * t3 - 3.0 * t2 + 1.0) * n0.value
+                 + (t3 - 2.0 * t2 + t) * step * n0.slope
+                 + (3.0 * t2 - 2.0 * t3) * n1.value
+                 + (t3 - t2) * step * n1.slope;
+        }
+
+        // The same for every lane: cell and fraction are found in lanes and
+        // only the node reads are per lane. Every lane must be covered.
+        LaneMath::Lanes operator()(LaneMath::Lanes p) const
+        {
+            using Lanes = LaneMath::Lanes;
+            
+            const Lanes position = LaneMath::clamp((p + range) * static_cast<double>(pointsPerUnit), 0.0, numPoints - 1.0);
+            const Lanes index = Lanes::min(Lanes::truncate(position), Lanes::expand(numPoints - 2.0));
+            const Lanes t = position - index;
+            const double step = 1.0 / pointsPerUnit;
+            
+            alignas(sizeof(Lanes)) double indices[Lanes::SIZE];
+            alignas(sizeof(Lanes)) double v0[Lanes::SIZE];
+            alignas(sizeof(Lanes)) double s0[Lanes::SIZE];
+            alignas(sizeof(Lanes)) double v1[Lanes::SIZE];
+            alignas(sizeof(Lanes)) double s1[Lanes::SIZE];
+            index.copyToRawArray(indices);
+            
+            for (size_t lane = 0; lane < Lanes::SIZE; ++lane)
+            {
+                const auto* cell = nodes.data() + static_cast<int>(indices[lane]);
+                const auto& n0 = cell[0];
+                const auto& n1 = cell[1];
+                v0[lane] = n0.value;
+                s0[lane] = n0.slope;
+                v1[lane] = n1.value;
+                s1[lane] = n1.slope;
+            }
+            
+            const Lanes t2 = t * t;
+            const Lanes t3 = t2 * t;
+            
+            return (t3 * 2.0 - t2 * 3.0 + 1.0) * Lanes::fromRawArray(v0)
+                 + (t3 - t2 * 2.0 + t) * (Lanes::fromRawArray(s0) * step)
+                 + (t2 * 3.0 - t3 * 2.0) * Lanes::fromRawArray(v1)
+                 + (t3 - t2) * (Lanes::fromRawArray(s1) * step);
+        }
+
+    private:
+        struct Node
+        {
+            double value;   // v(p)
+            double slope;   // dv/dp
+        };
+
+        std::array<Node, static_cast<size_t>(numPoints)> nodes {};
+    };
+}
@@ -1,103 +1,467 @@
 #include "NonlinearStateSpace.h"
 
+namespace
+{
+    using Lanes = LaneMath::Lanes;
+    
+    // Exact circuit nonlinearity with its tabulated antiderivatives, evaluated
+    // at the biased operating point. The scalar value and derivative feed the
+    // Newton solver; the block loop uses the lane versions.
+    template <double (*Function)(double)>
+    struct CircuitShaper
+    {
+        const AntiderivativeTable& table;
+        double bias;
+        
+        double value(double v) const { return Function(v + bias); }
+        double derivative(double v) const { return table.derivative(v + bias); }
+        
+        Lanes value(Lanes v) const { return LaneMath::applyLanewise(v + bias, Function); }
+        Lanes first(Lanes v) const { return table.firstAntiderivative(v + bias); }
+        Lanes second(Lanes v) const { return table.secondAntiderivative(v + bias); }
+    };
+    
+    // Fully table-driven circuit nonlinearity
+    struct TabulatedShaper
+    {
+        const AntiderivativeTable& table;
+        double bias;
+        
+        double value(double v) const { return table.function(v + bias); }
+        double derivative(double v) const { return table.derivative(v + bias); }
+        
+        Lanes value(Lanes v) const { return table.function(v + bias); }
+        Lanes first(Lanes v) const { return table.firstAntiderivative(v + bias); }
+        Lanes second(Lanes v) const { return table.secondAntiderivative(v + bias); }
+    };
+    
+    // Op-amp curve: unity gain up to the rails, then a shallow slope
+    constexpr double opAmpSaturationVoltage = 0.9;
+    constexpr double opAmpSaturatedSlope = 0.1;
+    
+    // The op-amp curve in closed form. It is piecewise linear, so its
+    // antiderivatives are exact piecewise polynomials; a Hermite table cannot
+    // follow the slope kinks at the rails. The lane versions pick the pieces
+    // with masks.
+    struct OpAmpShaper
+    {
+        double bias;
+        
+        double value(double v) const
+        {
+            const double x = v + bias;
+            const double excess = std::abs(x) - opAmpSaturationVoltage;
+            
+            if (excess <= 0.0)
+                return x;
+            
+            return std::copysign(opAmpSaturationVoltage + excess * opAmpSaturatedSlope, x);
+        }
+        
+        double derivative(double v) const
+        {
+            return std::abs(v + bias) <= opAmpSaturationVoltage ? 1.0 : opAmpSaturatedSlope;
+        }
+        
+        // Signed distance beyond the rails, zero between them
+        static Lanes getExcess(Lanes x)
+        {
+            return Lanes::max(x - opAmpSaturationVoltage, Lanes::expand(0.0))
+                 + Lanes::min(x + opAmpSaturationVoltage, Lanes::expand(0.0));
+        }
+        
+        Lanes value(Lanes v) const
+        {
+            const Lanes x = v + bias;
+            return x - getExcess(x) * (1.0 - opAmpSaturatedSlope);
+        }
+        
+        // F1 is even and F2 odd, both zero at zero like the tabulated ones
+        Lanes first(Lanes v) const
+        {
+            constexpr double s = opAmpSaturationVoltage;
+            const Lanes x = v + bias;
+            const Lanes excess = Lanes::abs(x) - s;
+            const Lanes saturated = excess * (excess * (0.5 * opAmpSaturatedSlope) + s) + 0.5 * s * s;
+            
+            return LaneMath::select(Lanes::lessThanOrEqual(excess, Lanes::expand(0.0)), x * x * 0.5, saturated);
+        }
+        
+        Lanes second(Lanes v) const
+        {
+            constexpr double s = opAmpSaturationVoltage;
+            const Lanes x = v + bias;
+            const Lanes excess = Lanes::abs(x) - s;
+            const Lanes magnitude = excess * (excess * (excess * (opAmpSaturatedSlope / 6.0) + 0.5 * s) + 0.5 * s * s)
+                                  + s * s * s / 6.0;
+            
+            // The odd extension: the signed excess over the rails carries the sign of x
+            const Lanes negative = Lanes::expand(0.0) - magnitude;
+            const Lanes saturated = LaneMath::select(Lanes::greaterThan(x, Lanes::expand(0.0)), magnitude, negative);
+            
+            return LaneMath::select(Lanes::lessThanOrEqual(excess, Lanes::expand(0.0)), x * x * x * (1.0 / 6.0), saturated);
+        }
+    };
+    
+    constexpr double tableRange = 16.0;
+    constexpr int tablePointsPerUnit = 128;
+    constexpr double maxTableError = 1.0e-4;
+    
+    AntiderivativeTable makeTable(double (*function)(double))
+    {
+        AntiderivativeTable table(function, tableRange, tablePointsPerUnit);
+        
+        // Interpolation error bound, checked against the exact curve
+        jassert (table.getMaxError() < maxTableError);
+        
+        return table;
+    }
+}
+
 NonlinearStateSpace::NonlinearStateSpace()
+    : solutionTableSlot(std::make_unique<SolutionTables::Slot>(*solutionTables))
+{
+    reset();
+}
+
+NonlinearStateSpace::SolutionTables::SolutionTables()
+    : SharedResourceRegistry("Solution tables", &NonlinearStateSpace::buildSolutionTable)
 {
-    x.fill(0.0);
-    xPrev.fill(0.0);
 }
 
 void NonlinearStateSpace::prepare(double sampleRate)
+{
+    // Make sure the shared tables exist before the audio thread needs them
+    if (circuitType != CircuitType::OpAmpSaturation)
+        getAntiderivativeTable(circuitType);
+    
+    restart(sampleRate);
+    
+    // Start with the table in place; only the first instance builds it
+    if (useLookupTables)
+        solutionTableSlot->fetch(getSolutionTableKey());
+}
+
+void NonlinearStateSpace::restart(double sampleRate)
 {
     this->sampleRate = sampleRate;
+    
+    driveSmoothed.reset(sampleRate, rampTimeSeconds);
+    driveSmoothed.setCurrentAndTargetValue(drive);
+    toneSmoothed.reset(sampleRate, rampTimeSeconds);
+    toneSmoothed.setCurrentAndTargetValue(tone);
+    
+    // Marks the solution table dirty, so the next block requests it
+    updateCircuit(tone);
     reset();
 }
 
 void NonlinearStateSpace::reset()
 {
-    x.fill(0.0);
-    xPrev.fill(0.0);
-    toneState = 0.0;
+    state.fill(Lanes::expand(0.0));
+    nonlinearVoltage = Lanes::expand(0.0);
+    toneState = Lanes::expand(0.0);
+    antialiasingState.reset();
 }
 
-float NonlinearStateSpace::processSample(float input)
+void NonlinearStateSpace::processBlock(const Lanes* input, Lanes* output, int numSamples)
 {
-    double inputScaled = static_cast<double>(input) * drive;
-    
-    // Update state-space model
-    updateState(inputScaled);
-    
-    // Apply nonlinearity based on circuit type
-    double output = 0.0;
+    // Dispatch on circuit type once per block so the sample loop is branch-free
     switch (circuitType)
     {
         case CircuitType::TubeTriode:
-            output = tubeTriodeNonlinearity(x[0]);
+            processBlock<CircuitType::TubeTriode>(input, output, numSamples);
             break;
         case CircuitType::TransistorBJT:
-            output = transistorBJTCurrent(x[0]);
+            processBlock<CircuitType::TransistorBJT>(input, output, numSamples);
             break;
         case CircuitType::DiodeClipper:
-            output = diodeClipperNonlinearity(x[0]);
+            processBlock<CircuitType::DiodeClipper>(input, output, numSamples);
             break;
         case CircuitType::OpAmpSaturation:
-            output = opAmpSaturationNonlinearity(x[0]);
+            processBlock<CircuitType::OpAmpSaturation>(input, output, numSamples);
+            break;
+    }
+}
+
+template <NonlinearStateSpace::CircuitType type>
+void NonlinearStateSpace::processBlock(const Lanes* input, Lanes* output, int numSamples)
+{
+    jassert (type == circuitType);
+    
+    // The transcendental curves run table-driven; the op-amp curve is
+    // piecewise linear and exact in closed form, antiderivatives included
+    if constexpr (type == CircuitType::OpAmpSaturation)
+    {
+        processBlockWith(input, output, numSamples, OpAmpShaper { bias });
+    }
+    else
+    {
+        const auto& table = getAntiderivativeTable(type);
+        
+        if (useLookupTables)
+            processBlockWith(input, output, numSamples, TabulatedShaper { table, bias });
+        else
+            processBlockWith(input, output, numSamples, CircuitShaper<getNonlinearity(type)> { table, bias });
+    }
+}
+
+template <typename Shaper>
+void NonlinearStateSpace::processBlockWith(const Lanes* input, Lanes* output, int numSamples,
+                                           const Shaper& shaper)
+{
+    switch (antialiasingMode)
+    {
+        case AntialiasingMode::Off:
+            processBlockWith<AntialiasingMode::Off>(input, output, numSamples, shaper);
+            break;
+        case AntialiasingMode::FirstOrder:
+            processBlockWith<AntialiasingMode::FirstOrder>(input, output, numSamples, shaper);
             break;
+        case AntialiasingMode::SecondOrder:
+            processBlockWith<AntialiasingMode::SecondOrder>(input, output, numSamples, shaper);
+            break;
+    }
+}
+
+template <AntialiasingMode mode, typename Shaper>
+void NonlinearStateSpace::processBlockWith(const Lanes* input, Lanes* output, int numSamples,
+                                           const Shaper& shaper)
+{
+    // The matrices are only derived when tone moves. While it ramps they are
+    // built once for the tone reached at the end of the block and stepped
+    // towards it per sample, and the Newton solver takes over from the
+    // solution table.
+    bool interpolating = false;
+    CircuitMatrices targetMatrices, matrixStep;
+    
+    if (toneSmoothed.isSmoothing())
+    {
+        auto endOfBlock = toneSmoothed;
+        const double endTone = endOfBlock.skip(numSamples);
+        
+        if (endTone != matrixTone)
+        {
+            targetMatrices = getCircuitMatrices(endTone);
+            matrixStep = CircuitMatrices::getStep(matrices, targetMatrices, numSamples);
+            matrixTone = endTone;
+            solutionTableDirty = true;
+            interpolating = true;
+        }
+    }
+    else if (toneSmoothed.getCurrentValue() != matrixTone)
+    {
+        updateCircuit(toneSmoothed.getCurrentValue());
     }
     
-    // Apply tone control (simple high-frequency roll-off)
-    double toneAlpha = tone;
-    toneState = toneAlpha * output + (1.0 - toneAlpha) * toneState;
-    output = output * (1.0 - tone * 0.3) + toneState * (tone * 0.3);
+    const DK::SolutionTable* solutionTable = nullptr;
+    
+    if (useLookupTables && ! toneSmoothed.isSmoothing())
+    {
+        const auto key = getSolutionTableKey();
+        
+        if (solutionTableDirty)
+        {
+            solutionTableSlot->request(key);
+            solutionTableDirty = false;
+        }
+        
+        // Null until the registry has the table for these settings
+        solutionTable = solutionTableSlot->get(key);
+    }
     
-    // Normalize output
-    output = juce::jlimit(-1.0, 1.0, output);
+    const auto& m = matrices;
     
-    return static_cast<float>(output);
+    for (int i = 0; i < numSamples; ++i)
+    {
+        double currentTone = toneSmoothed.getNextValue();
+        
+        if (interpolating)
+            matrices.advance(matrixStep);
+        
+        Lanes u = input[i] * driveSmoothed.getNextValue();
+        
+        // Linear prediction of the control voltage from the previous state
+        Lanes p = u * m.H;
+        for (size_t k = 0; k < numStates; ++k)
+            p += state[k] * m.G[k];
+        
+        // Solve v = p + K f(v), read from the table in all lanes at once when
+        // it covers them, otherwise per channel warm-started from the last sample
+        Lanes v;
+        if (solutionTable != nullptr && solutionTable->covers(p))
+        {
+            v = (*solutionTable)(p);
+        }
+        else
+        {
+            alignas(sizeof(Lanes)) double predictions[Lanes::SIZE];
+            alignas(sizeof(Lanes)) double roots[Lanes::SIZE];
+            p.copyToRawArray(predictions);
+            nonlinearVoltage.copyToRawArray(roots);
+            
+            for (size_t lane = 0; lane < Lanes::SIZE; ++lane)
+            {
+                const double pLane = predictions[lane];
+                roots[lane] = solutionTable != nullptr && solutionTable->covers(pLane)
+                                  ? (*solutionTable)(pLane)
+                                  : DK::solve(pLane, m.K, roots[lane], shaper);
+            }
+            
+            v = Lanes::fromRawArray(roots);
+        }
+        nonlinearVoltage = v;
+        
+        Lanes current = shaper.value(v);
+        
+        // The device contribution to the output goes through the anti-aliased
+        // nonlinearity; the state update keeps the exact solution
+        Lanes device = current;
+        if constexpr (mode != AntialiasingMode::Off)
+            device = ADAA::process<mode>(v, antialiasingState, shaper);
+        
+        Lanes out = u * m.E + device * m.F;
+        for (size_t k = 0; k < numStates; ++k)
+            out += state[k] * m.D[k];
+        
+        std::array<Lanes, numStates> next;
+        for (size_t k = 0; k < numStates; ++k)
+        {
+            next[k] = u * m.B[k] + current * m.C[k];
+            for (size_t j = 0; j < numStates; ++j)
+                next[k] += state[j] * m.A[k][j];
+        }
+        state = next;
+        
+        // Apply tone control (simple high-frequency roll-off)
+        toneState = out * currentTone + toneState * (1.0 - currentTone);
+        out = out * (1.0 - currentTone * 0.3) + toneState * (currentTone * 0.3);
+        
+        // Normalize output
+        output[i] = LaneMath::clamp(out, -1.0, 1.0);
+    }
+    
+    // Land exactly on the target, free of accumulated rounding
+    if (interpolating)
+        matrices = targetMatrices;
 }
 
 void NonlinearStateSpace::setCircuitType(CircuitType type)
 {
+    if (type == circuitType)
+        return;
+    
     circuitType = type;
+    solutionTableDirty = true;
     reset();
 }
 
 void NonlinearStateSpace::setDrive(double drive)
 {
     this->drive = juce::jlimit(0.1, 10.0, drive);
+    driveSmoothed.setTargetValue(this->drive);
 }
 
 void NonlinearStateSpace::setTone(double tone)
 {
     this->tone = juce::jlimit(0.0, 1.0, tone);
+    toneSmoothed.setTargetValue(this->tone);
 }
 
 void NonlinearStateSpace::setBias(double bias)
 {
-    this->bias = juce::jlimit(-1.0, 1.0, bias);
+    bias = juce::jlimit(-1.0, 1.0, bias);
+    if (bias == this->bias)
+        return;
+    
+    this->bias = bias;
+    solutionTableDirty = true;
 }
 
-void NonlinearStateSpace::updateState(double input)
+void NonlinearStateSpace::setAntialiasingMode(AntialiasingMode mode)
 {
-    // State-space representation: x' = Ax + Bu, y = Cx + Du
-    // Simplified second-order system with nonlinear feedback
+    if (mode == antialiasingMode)
+        return;
     
-    double dt = 1.0 / sampleRate;
-    double alpha = 0.99;  // Damping
+    antialiasingMode = mode;
+    antialiasingState.reset();
+}
+
+void NonlinearStateSpace::setUseLookupTables(bool shouldUseTables)
+{
+    if (shouldUseTables == useLookupTables)
+        return;
     
-    // State update (simplified)
-    xPrev = x;
+    useLookupTables = shouldUseTables;
+    solutionTableDirty = true;
+}
+
+const AntiderivativeTable& NonlinearStateSpace::getAntiderivativeTable(CircuitType type)
+{
+    static const AntiderivativeTable tubeTriode = makeTable(tubeTriodeNonlinearity);
+    static const AntiderivativeTable transistorBJT = makeTable(transistorBJTCurrent);
+    static const AntiderivativeTable diodeClipper = makeTable(diodeClipperNonlinearity);
     
-    // First-order low-pass to model circuit dynamics
-    double cutoff = 20000.0 * (1.0 - tone * 0.8);
-    double rc = 1.0 / (2.0 * juce::MathConstants<double>::pi * cutoff);
-    double alpha_lp = dt / (rc + dt);
+    switch (type)
+    {
+        case CircuitType::TransistorBJT:
+            return transistorBJT;
+        case CircuitType::DiodeClipper:
+            return diodeClipper;
+        case CircuitType::OpAmpSaturation:
+            // Evaluated in closed form; there is no table to return
+            jassertfalse;
+            return tubeTriode;
+        case CircuitType::TubeTriode:
+        default:
+            return tubeTriode;
+    }
+}
+
+void NonlinearStateSpace::buildSolutionTable(const SolutionTableKey& key, DK::SolutionTable& table)
+{
+    // The same shapers the block loop uses with lookup tables on
+    switch (key.circuitType)
+    {
+        case CircuitType::OpAmpSaturation:
+            table.build(key.K, OpAmpShaper { key.bias });
+            break;
+        case CircuitType::TubeTriode:
+        case CircuitType::TransistorBJT:
+        case CircuitType::DiodeClipper:
+        default:
+            table.build(key.K, TabulatedShaper { getAntiderivativeTable(key.circuitType), key.bias });
+            break;
+    }
+}
+
+void NonlinearStateSpace::updateCircuit(double toneValue)
+{
+    matrices = getCircuitMatrices(toneValue);
+    matrixTone = toneValue;
+    solutionTableDirty = true;
+}
+
+NonlinearStateSpace::CircuitMatrices NonlinearStateSpace::getCircuitMatrices(double toneValue) const
+{
+    // The shunt capacitor sets the input corner, 20 kHz down to 4 kHz with tone
+    double cutoff = 20000.0 * (1.0 - toneValue * 0.8);
+    double shuntCapacitance = 1.0 / (2.0 * juce::MathConstants<double>::pi * inputResistance * cutoff);
     
-    x[0] = alpha_lp * (input + bias) + (1.0 - alpha_lp) * x[0];
+    // The device drives -f(v) into the output node through its output
+    // resistance; the stage output is re-inverted
+    DK::Netlist<numNodes, numStates> netlist;
+    netlist.setInput(1, inputResistance);
+    netlist.addCapacitor(1, 0, shuntCapacitance);
+    netlist.addCapacitor(1, 2, millerCapacitance);
+    netlist.addResistor(2, 0, outputResistance);
+    netlist.addResistor(2, 0, loadResistance);
+    netlist.setNonlinearity(1, 2, -1.0 / outputResistance);
+    netlist.setOutput(2, -1.0);
     
-    // Higher-order states for more complex dynamics
-    x[1] = alpha * x[1] + (1.0 - alpha) * x[0];
-    x[2] = alpha * x[2] + (1.0 - alpha) * x[1];
-    x[3] = alpha * x[3] + (1.0 - alpha) * x[2];
+    CircuitMatrices result;
+    result.update(netlist, sampleRate);
+    return result;
 }
 
 double NonlinearStateSpace::tubeTriodeNonlinearity(double v)
@@ -106,7 +470,7 @@ double NonlinearStateSpace::tubeTriodeNonlinearity(double v)
     // I = k * (Vg + mu*Vp)^(3/2)
     // Simplified for audio processing
     
-    double vg = v + bias;
+    double vg = v;
     double mu = 100.0;  // Amplification factor
     double k = 0.001;
     
@@ -129,7 +493,7 @@ double NonlinearStateSpace::transistorBJTCurrent(double v)
     // Ebers-Moll model approximation
     // I = Is * (exp(V/Vt) - 1)
     
-    double vbe = v + bias;
+    double vbe = v;
     double current = Is * (std::exp(vbe / Vt) - 1.0);
     
     // Add collector saturation
@@ -148,7 +512,7 @@ double NonlinearStateSpace::diodeClipperNonlinearity(double v)
     // Shockley diode equation: I = Is * (exp(V/Vt) - 1)
     // For clipping, we model the forward and reverse characteristics
     
-    double vd = v + bias;
+    double vd = v;
     
     if (vd > 0.0)
     {
@@ -169,8 +533,8 @@ double NonlinearStateSpace::opAmpSaturationNonlinearity(double v)
     // Operational amplifier saturation
     // Hard clipping with soft edges
     
-    double vIn = v + bias;
-    double saturationVoltage = 0.9;
+    double vIn = v;
+    double saturationVoltage = opAmpSaturationVoltage;
     
     if (std::abs(vIn) < saturationVoltage)
     {
@@ -180,7 +544,7 @@ double NonlinearStateSpace::opAmpSaturationNonlinearity(double v)
     {
         double sign = vIn >= 0.0 ? 1.0 : -1.0;
         double excess = std::abs(vIn) - saturationVoltage;
-        return sign * (saturationVoltage + excess * 0.1);
+        return sign * (saturationVoltage + excess * opAmpSaturatedSlope);
     }
 }
 
@@ -211,3 +575,9 @@ double NonlinearStateSpace::asymmetricSaturation(double x)
         return std::tanh(x * 1.1);
     }
 }
+
+// Compile-time circuit entry points, used by the CircuitModels kernels
+template void NonlinearStateSpace::processBlock<NonlinearStateSpace::CircuitType::TubeTriode>(const Lanes*, Lanes*, int);
+template void NonlinearStateSpace::processBlock<NonlinearStateSpace::CircuitType::TransistorBJT>(const Lanes*, Lanes*, int);
+template void NonlinearStateSpace::processBlock<NonlinearStateSpace::CircuitType::DiodeClipper>(const Lanes*, Lanes*, int);
+template void NonlinearStateSpace::processBlock<NonlinearStateSpace::CircuitType::OpAmpSaturation>(const Lanes*, Lanes*, int);
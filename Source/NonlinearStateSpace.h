@@ -1,12 +1,25 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "AntiderivativeAntialiasing.h"
+#include "LaneMath.h"
+#include "NodalStateSpace.h"
+#include "SharedResourceRegistry.h"
 #include <array>
+#include <memory>
 
 /**
  * Nonlinear State-Space model for analog saturation circuits.
  * Models circuits with nonlinear elements (diodes, transistors) using
  * state-space formulations for accurate dynamic behavior.
+ *
+ * The circuit is an inverting gain stage: the input drives the control node
+ * through a resistor, loaded by a tone-dependent shunt capacitor and a Miller
+ * capacitor back from the output node. The selected circuit curve acts as the
+ * device transfer inside that feedback loop and is solved per sample with the
+ * DK method.
+ *
+ * Each SIMD lane carries one independent audio channel.
  */
 class NonlinearStateSpace
 {
@@ -20,48 +33,155 @@ public:
     };
     
     NonlinearStateSpace();
+    NonlinearStateSpace(NonlinearStateSpace&&) = default;
     ~NonlinearStateSpace() = default;
     
+    // Off the audio thread: restart at sampleRate with the solution table
+    // for the current settings already in place
     void prepare(double sampleRate);
+    
+    // Audio thread: restart at sampleRate, snapping the smoothed parameters
+    // and clearing the state. The solution table is only requested, so this
+    // neither locks nor allocates; the Newton solver stands in until the
+    // registry has published it.
+    void restart(double sampleRate);
+    
     void reset();
     
-    float processSample(float input);
+    using Lanes = LaneMath::Lanes;
+    
+    // Process a block of lane vectors; the circuit nonlinearity is resolved once
+    // per block and drive/tone changes are ramped across it
+    void processBlock(const Lanes* input, Lanes* output, int numSamples);
+    
+    // Same, with the circuit fixed at compile time. type must match the
+    // current circuit type; instantiated for every CircuitType.
+    template <CircuitType type>
+    void processBlock(const Lanes* input, Lanes* output, int numSamples);
     
     void setCircuitType(CircuitType type);
     void setDrive(double drive);
     void setTone(double tone);
     void setBias(double bias);
+    void setAntialiasingMode(AntialiasingMode mode);
+    
+    // Evaluate the circuit nonlinearity from its lookup table (default) or
+    // from the exact transcendental expression
+    void setUseLookupTables(bool shouldUseTables);
+    
+    // Tabulated nonlinearity and antiderivatives for a circuit type, shared
+    // read-only by all instances and built on first use. The op-amp curve is
+    // piecewise linear and evaluated in closed form, so it has no table.
+    static const AntiderivativeTable& getAntiderivativeTable(CircuitType type);
     
 private:
     double sampleRate = 44100.0;
     CircuitType circuitType = CircuitType::TubeTriode;
     
-    // State variables
-    std::array<double, 4> x;  // State vector
-    std::array<double, 4> xPrev;  // Previous state
-    
     // Parameters
     double drive = 1.0;
     double tone = 0.5;
     double bias = 0.0;
     
+    juce::SmoothedValue<double> driveSmoothed;
+    juce::SmoothedValue<double> toneSmoothed;
+    
+    static constexpr double rampTimeSeconds = 0.02;
+    
+    // Circuit: nodes 1 (control) and 2 (output), states are the two capacitors
+    static constexpr int numNodes = 2;
+    static constexpr int numStates = 2;
+    
+    static constexpr double inputResistance = 10.0e3;
+    static constexpr double millerCapacitance = 220.0e-12;
+    static constexpr double outputResistance = 1.0e3;
+    static constexpr double loadResistance = 100.0e3;
+    
+    // Discretised system, derived only when tone or the sample rate changes
+    // and interpolated per sample while tone ramps. matrixTone is the tone
+    // the matrices reach by the end of the current block.
+    using CircuitMatrices = DK::Matrices<numNodes, numStates>;
+    CircuitMatrices matrices;
+    double matrixTone = -1.0;
+    
+    // Capacitor states and the last nonlinear solution (Newton warm start)
+    std::array<Lanes, numStates> state;
+    Lanes nonlinearVoltage = Lanes::expand(0.0);
+    
+    // Precomputed roots of the implicit equation, used while tone is steady.
+    // A table depends only on the nonlinearity, the bias and K (which folds
+    // in the sample rate and tone), so the tables live in a process-wide
+    // registry: instances with the same settings share one copy, and a new
+    // one is built off the audio thread while the Newton solver stands in.
+    struct SolutionTableKey
+    {
+        CircuitType circuitType = CircuitType::TubeTriode;
+        double K = 0.0;
+        double bias = 0.0;
+        
+        bool operator==(const SolutionTableKey& other) const
+        {
+            return circuitType == other.circuitType && K == other.K && bias == other.bias;
+        }
+    };
+    
+    class SolutionTables : public SharedResourceRegistry<SolutionTableKey, DK::SolutionTable>
+    {
+    public:
+        SolutionTables();
+    };
+    
+    static void buildSolutionTable(const SolutionTableKey& key, DK::SolutionTable& table);
+    
+    SolutionTableKey getSolutionTableKey() const { return { circuitType, matrices.K, bias }; }
+    
+    juce::SharedResourcePointer<SolutionTables> solutionTables;
+    std::unique_ptr<SolutionTables::Slot> solutionTableSlot;
+    bool solutionTableDirty = true;
+    
     // Tone control state (per-instance)
-    double toneState = 0.0;
+    Lanes toneState = Lanes::expand(0.0);
+    
+    // Anti-aliasing
+    AntialiasingMode antialiasingMode = AntialiasingMode::Off;
+    AntialiasingState antialiasingState;
+    
+    bool useLookupTables = true;
     
     // Circuit-specific parameters
-    double Vt = 26e-3;  // Thermal voltage (26mV at room temp)
-    double Is = 1e-12;  // Saturation current
+    static constexpr double Vt = 26e-3;  // Thermal voltage (26mV at room temp)
+    static constexpr double Is = 1e-12;  // Saturation current
+    
+    // Nonlinear functions for different circuit types; v includes the bias
+    static double tubeTriodeNonlinearity(double v);
+    static double transistorBJTCurrent(double v);
+    static double diodeClipperNonlinearity(double v);
+    static double opAmpSaturationNonlinearity(double v);
+    
+    static constexpr double (*getNonlinearity(CircuitType type))(double)
+    {
+        switch (type)
+        {
+            case CircuitType::TransistorBJT:   return transistorBJTCurrent;
+            case CircuitType::DiodeClipper:    return diodeClipperNonlinearity;
+            case CircuitType::OpAmpSaturation: return opAmpSaturationNonlinearity;
+            case CircuitType::TubeTriode:
+            default:                           return tubeTriodeNonlinearity;
+        }
+    }
+    
+    // Block loops specialised for one circuit nonlinearity and ADAA order
+    template <typename Shaper>
+    void processBlockWith(const Lanes* input, Lanes* output, int numSamples, const Shaper& shaper);
     
-    // Nonlinear functions for different circuit types
-    double tubeTriodeNonlinearity(double v);
-    double transistorBJTCurrent(double v);
-    double diodeClipperNonlinearity(double v);
-    double opAmpSaturationNonlinearity(double v);
+    template <AntialiasingMode mode, typename Shaper>
+    void processBlockWith(const Lanes* input, Lanes* output, int numSamples, const Shaper& shaper);
     
-    // State-space update
-    void updateState(double input);
+    // Rebuild the system matrices for a tone setting
+    void updateCircuit(double toneValue);
+    CircuitMatrices getCircuitMatrices(double toneValue) const;
     
     // Helper functions
-    double softClip(double x, double threshold);
-    double asymmetricSaturation(double x);
+    static double softClip(double x, double threshold);
+    static double asymmetricSaturation(double x);
 };
@@ -3,7 +3,7 @@
 
 //==============================================================================
 AnalogSaturationAudioProcessorEditor::AnalogSaturationAudioProcessorEditor (AnalogSaturationAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p), analysisDisplay (p)
 {
     // Drive slider
     driveSlider.setSliderStyle(juce::Slider::RotaryVerticalDrag);
@@ -78,11 +78,90 @@ AnalogSaturationAudioProcessorEditor::AnalogSaturationAudioProcessorEditor (Anal
     modelTypeAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
         audioProcessor.getValueTreeState(), "modelType", modelTypeCombo);
     
-    setSize (600, 400);
+    // Oversampling factor combo (0-indexed for parameter)
+    oversamplingCombo.addItem("1x", 1);
+    oversamplingCombo.addItem("2x", 2);
+    oversamplingCombo.addItem("4x", 3);
+    oversamplingCombo.addItem("8x", 4);
+    oversamplingCombo.setSelectedId(1);
+    addAndMakeVisible(oversamplingCombo);
+    
+    oversamplingLabel.setText("Oversampling", juce::dontSendNotification);
+    oversamplingLabel.attachToComponent(&oversamplingCombo, false);
+    addAndMakeVisible(oversamplingLabel);
+    
+    oversamplingAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+        audioProcessor.getValueTreeState(), "oversampling", oversamplingCombo);
+    
+    // Oversampling filter phase combo (0-indexed for parameter)
+    oversamplingModeCombo.addItem("Minimum Phase", 1);
+    oversamplingModeCombo.addItem("Linear Phase", 2);
+    oversamplingModeCombo.setSelectedId(1);
+    addAndMakeVisible(oversamplingModeCombo);
+    
+    oversamplingModeLabel.setText("Oversampling Filter", juce::dontSendNotification);
+    oversamplingModeLabel.attachToComponent(&oversamplingModeCombo, false);
+    addAndMakeVisible(oversamplingModeLabel);
+    
+    oversamplingModeAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+        audioProcessor.getValueTreeState(), "oversamplingMode", oversamplingModeCombo);
+    
+    // Anti-aliasing combo (0-indexed for parameter)
+    antialiasingCombo.addItem("Off", 1);
+    antialiasingCombo.addItem("ADAA 1st Order", 2);
+    antialiasingCombo.addItem("ADAA 2nd Order", 3);
+    antialiasingCombo.setSelectedId(1);
+    addAndMakeVisible(antialiasingCombo);
+    
+    antialiasingLabel.setText("Anti-aliasing", juce::dontSendNotification);
+    antialiasingLabel.attachToComponent(&antialiasingCombo, false);
+    addAndMakeVisible(antialiasingLabel);
+    
+    antialiasingAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+        audioProcessor.getValueTreeState(), "antialiasing", antialiasingCombo);
+    
+    // Automatic quality scaling against a CPU budget
+    autoQualityButton.setButtonText("Auto Quality");
+    addAndMakeVisible(autoQualityButton);
+    
+    autoQualityAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        audioProcessor.getValueTreeState(), "autoQuality", autoQualityButton);
+    
+    cpuBudgetSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    cpuBudgetSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 60, 20);
+    cpuBudgetSlider.setTextValueSuffix(" %");
+    addAndMakeVisible(cpuBudgetSlider);
+    
+    cpuBudgetLabel.setText("CPU Budget", juce::dontSendNotification);
+    cpuBudgetLabel.attachToComponent(&cpuBudgetSlider, false);
+    addAndMakeVisible(cpuBudgetLabel);
+    
+    cpuBudgetAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getValueTreeState(), "cpuBudget", cpuBudgetSlider);
+    
+    qualityStatusLabel.setJustificationType(juce::Justification::centredRight);
+    addAndMakeVisible(qualityStatusLabel);
+    
+    // Level meters, output spectrum and transfer curve
+    addAndMakeVisible(analysisDisplay);
+    
+    setSize (600, 760);
+    startTimerHz(10);
 }
 
 AnalogSaturationAudioProcessorEditor::~AnalogSaturationAudioProcessorEditor()
 {
+    stopTimer();
+}
+
+void AnalogSaturationAudioProcessorEditor::timerCallback()
+{
+    const int load = juce::roundToInt(audioProcessor.getCpuLoad() * 100.0f);
+    const int tier = audioProcessor.getQualityTier();
+    
+    qualityStatusLabel.setText("CPU " + juce::String(load) + " %"
+                                   + (tier > 0 ? ", quality tier " + juce::String(tier) : juce::String()),
+                               juce::dontSendNotification);
 }
 
 //==============================================================================
@@ -121,4 +200,26 @@ void AnalogSaturationAudioProcessorEditor::resized()
     
     circuitTypeCombo.setBounds(comboArea.removeFromLeft(comboWidth).reduced(10, 20));
     modelTypeCombo.setBounds(comboArea.reduced(10, 20));
+    
+    area.removeFromTop(20);
+    
+    auto qualityArea = area.removeFromTop(60);
+    auto qualityWidth = qualityArea.getWidth() / 3;
+    
+    oversamplingCombo.setBounds(qualityArea.removeFromLeft(qualityWidth).reduced(10, 20));
+    oversamplingModeCombo.setBounds(qualityArea.removeFromLeft(qualityWidth).reduced(10, 20));
+    antialiasingCombo.setBounds(qualityArea.reduced(10, 20));
+    
+    area.removeFromTop(20);
+    
+    auto budgetArea = area.removeFromTop(60);
+    auto budgetWidth = budgetArea.getWidth() / 3;
+    
+    autoQualityButton.setBounds(budgetArea.removeFromLeft(budgetWidth).reduced(10, 20));
+    cpuBudgetSlider.setBounds(budgetArea.removeFromLeft(budgetWidth).reduced(10, 20));
+    qualityStatusLabel.setBounds(budgetArea.reduced(10, 20));
+    
+    area.removeFromTop(20);
+    
+    analysisDisplay.setBounds(area.reduced(10, 0));
 }
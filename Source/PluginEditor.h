@@ -2,11 +2,13 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "AnalysisDisplay.h"
 
 //==============================================================================
 /**
 */
-class AnalogSaturationAudioProcessorEditor  : public juce::AudioProcessorEditor
+class AnalogSaturationAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                              private juce::Timer
 {
 public:
     AnalogSaturationAudioProcessorEditor (AnalogSaturationAudioProcessor&);
@@ -39,5 +41,30 @@ private:
     juce::Label modelTypeLabel;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> modelTypeAttachment;
     
+    juce::ComboBox oversamplingCombo;
+    juce::Label oversamplingLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> oversamplingAttachment;
+    
+    juce::ComboBox oversamplingModeCombo;
+    juce::Label oversamplingModeLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> oversamplingModeAttachment;
+    
+    juce::ComboBox antialiasingCombo;
+    juce::Label antialiasingLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> antialiasingAttachment;
+    
+    juce::ToggleButton autoQualityButton;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> autoQualityAttachment;
+    
+    juce::Slider cpuBudgetSlider;
+    juce::Label cpuBudgetLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> cpuBudgetAttachment;
+    
+    juce::Label qualityStatusLabel;
+    
+    AnalysisDisplay analysisDisplay;
+    
+    void timerCallback() override;
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalogSaturationAudioProcessorEditor)
 };
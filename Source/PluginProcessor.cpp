@@ -27,13 +27,39 @@ AnalogSaturationAudioProcessor::AnalogSaturationAudioProcessor()
                    std::make_unique<juce::AudioParameterInt>(CIRCUIT_TYPE_ID, "Circuit Type",
                                                              0, 3, 0),
                    std::make_unique<juce::AudioParameterInt>(MODEL_TYPE_ID, "Model Type",
-                                                             0, 2, 2)
+                                                             0, 2, 2),
+                   std::make_unique<juce::AudioParameterInt>(OVERSAMPLING_ID, "Oversampling",
+                                                             0, 3, 0),
+                   std::make_unique<juce::AudioParameterInt>(OVERSAMPLING_MODE_ID, "Oversampling Mode",
+                                                             0, 1, 0),
+                   std::make_unique<juce::AudioParameterInt>(ANTIALIASING_ID, "Anti-aliasing",
+                                                             0, 2, 0),
+                   std::make_unique<juce::AudioParameterBool>(AUTO_QUALITY_ID, "Auto Quality", false),
+                   std::make_unique<juce::AudioParameterFloat>(CPU_BUDGET_ID, "CPU Budget",
+                                                                juce::NormalisableRange<float>(10.0f, 100.0f, 1.0f),
+                                                                50.0f,
+                                                                juce::AudioParameterFloatAttributes().withLabel("%")),
+                   // Read-only meters, written by the processor
+                   std::make_unique<juce::AudioParameterFloat>(CPU_LOAD_ID, "CPU Load",
+                                                                juce::NormalisableRange<float>(0.0f, 100.0f),
+                                                                0.0f,
+                                                                juce::AudioParameterFloatAttributes()
+                                                                    .withLabel("%")
+                                                                    .withAutomatable(false)
+                                                                    .withCategory(juce::AudioProcessorParameter::otherMeter)),
+                   std::make_unique<juce::AudioParameterInt>(QUALITY_TIER_ID, "Quality Tier",
+                                                             0, numModelTiers + 3, 0,
+                                                             juce::AudioParameterIntAttributes()
+                                                                 .withAutomatable(false)
+                                                                 .withCategory(juce::AudioProcessorParameter::otherMeter))
                })
 {
+    startTimerHz(20);
 }
 
 AnalogSaturationAudioProcessor::~AnalogSaturationAudioProcessor()
 {
+    stopTimer();
 }
 
 //==============================================================================
@@ -71,7 +97,7 @@ bool AnalogSaturationAudioProcessor::isMidiEffect() const
 
 double AnalogSaturationAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return tailLengthSeconds.load();
 }
 
 int AnalogSaturationAudioProcessor::getNumPrograms()
@@ -105,12 +131,31 @@ void AnalogSaturationAudioProcessor::prepareToPlay (double sampleRate, int sampl
     spec.maximumBlockSize = static_cast<juce::uint32>(samplesPerBlock);
     spec.numChannels = static_cast<juce::uint32>(getTotalNumOutputChannels());
     
-    saturationEngine.prepare(spec);
+    loadMeasurer.reset(sampleRate, samplesPerBlock);
+    qualityGovernor.prepare(sampleRate);
+    qualityTier.store(0);
+    
+    if (isUsingDoublePrecision())
+        prepareEngine (doubleEngine, spec);
+    else
+        prepareEngine (floatEngine, spec);
+}
+
+template <typename SampleType>
+void AnalogSaturationAudioProcessor::prepareEngine (SaturationEngine<SampleType>& engine,
+                                                    const juce::dsp::ProcessSpec& spec)
+{
+    updateEngineParameters(engine);
+    engine.prepare(spec);
+    pendingLatencySamples.store(engine.getLatencySamples());
+    setLatencySamples(engine.getLatencySamples());
+    tailLengthSeconds.store(engine.getTailLengthSeconds());
 }
 
 void AnalogSaturationAudioProcessor::releaseResources()
 {
-    saturationEngine.reset();
+    floatEngine.reset();
+    doubleEngine.reset();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -120,8 +165,8 @@ bool AnalogSaturationAudioProcessor::isBusesLayoutSupported (const BusesLayout&
     juce::ignoreUnused (layouts);
     return true;
   #else
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any channel count works; the engine packs channels into SIMD lane groups
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     #if ! JucePlugin_IsSynth
@@ -137,7 +182,19 @@ bool AnalogSaturationAudioProcessor::isBusesLayoutSupported (const BusesLayout&
 void AnalogSaturationAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ignoreUnused (midiMessages);
+    process (buffer, floatEngine);
+}
+
+void AnalogSaturationAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    juce::ignoreUnused (midiMessages);
+    process (buffer, doubleEngine);
+}
 
+template <typename SampleType>
+void AnalogSaturationAudioProcessor::process (juce::AudioBuffer<SampleType>& buffer,
+                                              SaturationEngine<SampleType>& engine)
+{
     juce::ScopedNoDenormals noDenormals;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
@@ -146,14 +203,105 @@ void AnalogSaturationAudioProcessor::processBlock (juce::AudioBuffer<float>& buf
         buffer.clear (i, 0, buffer.getNumSamples());
 
     // Update parameters
-    saturationEngine.setDrive(*parameters.getRawParameterValue(DRIVE_ID));
-    saturationEngine.setTone(*parameters.getRawParameterValue(TONE_ID));
-    saturationEngine.setMix(*parameters.getRawParameterValue(MIX_ID));
-    saturationEngine.setCircuitType(static_cast<int>(*parameters.getRawParameterValue(CIRCUIT_TYPE_ID)));
-    saturationEngine.setModelType(static_cast<int>(*parameters.getRawParameterValue(MODEL_TYPE_ID)));
+    updateEngineParameters (engine);
+
+    // Oversampling changes alter the reported latency
+    pendingLatencySamples.store (engine.getLatencySamples());
+
+    tailLengthSeconds.store (engine.getTailLengthSeconds());
 
     // Process audio
-    saturationEngine.processBlock(buffer);
+    {
+        juce::AudioProcessLoadMeasurer::ScopedTimer timer (loadMeasurer, buffer.getNumSamples());
+        analysisFifo.beginBlock (buffer);
+        engine.processBlock(buffer);
+        analysisFifo.endBlock (buffer);
+    }
+
+    updateQualityTier (buffer.getNumSamples());
+}
+
+void AnalogSaturationAudioProcessor::updateQualityTier (int numSamples)
+{
+    const auto load = loadMeasurer.getLoadAsProportion();
+    cpuLoad.store (static_cast<float>(load));
+
+    if (*parameters.getRawParameterValue(AUTO_QUALITY_ID) < 0.5f)
+    {
+        qualityGovernor.reset();
+        qualityTier.store (0);
+        return;
+    }
+
+    // Every oversampling stage in use is one more tier to give up
+    const int oversampling = static_cast<int>(*parameters.getRawParameterValue(OVERSAMPLING_ID));
+
+    qualityGovernor.setBudget (*parameters.getRawParameterValue(CPU_BUDGET_ID) / 100.0);
+    qualityGovernor.setMaximumTier (numModelTiers + oversampling);
+    qualityTier.store (qualityGovernor.update (load, numSamples));
+}
+
+template <typename SampleType>
+void AnalogSaturationAudioProcessor::updateEngineParameters (SaturationEngine<SampleType>& engine)
+{
+    int modelType = static_cast<int>(*parameters.getRawParameterValue(MODEL_TYPE_ID));
+    int oversampling = static_cast<int>(*parameters.getRawParameterValue(OVERSAMPLING_ID));
+    int antialiasing = static_cast<int>(*parameters.getRawParameterValue(ANTIALIASING_ID));
+    
+    // Apply the quality tier on top of the user's settings. Model and
+    // oversampling changes both crossfade from the old setting.
+    const int tier = qualityTier.load();
+    
+    if (tier >= 1 && modelType == 2)
+        modelType = 1;  // Hybrid to State-Space
+    
+    if (tier >= 2)
+        antialiasing = juce::jmin(antialiasing, 1);
+    
+    // Lower factors keep the selected factor's latency, so the tier never
+    // moves the host's delay compensation
+    engine.setLatencyOversampling(oversampling);
+    oversampling = juce::jmax(0, oversampling - juce::jmax(0, tier - numModelTiers));
+    
+    engine.setDrive(*parameters.getRawParameterValue(DRIVE_ID));
+    engine.setTone(*parameters.getRawParameterValue(TONE_ID));
+    engine.setMix(*parameters.getRawParameterValue(MIX_ID));
+    engine.setCircuitType(static_cast<int>(*parameters.getRawParameterValue(CIRCUIT_TYPE_ID)));
+    engine.setModelType(modelType);
+    engine.setOversampling(oversampling);
+    engine.setOversamplingMode(static_cast<int>(*parameters.getRawParameterValue(OVERSAMPLING_MODE_ID)));
+    engine.setAntialiasing(antialiasing);
+}
+
+void AnalogSaturationAudioProcessor::timerCallback()
+{
+    const int latency = pendingLatencySamples.load();
+    if (latency != getLatencySamples())
+        setLatencySamples (latency);
+
+    setMeterParameter (CPU_LOAD_ID, std::round (cpuLoad.load() * 100.0f));
+    setMeterParameter (QUALITY_TIER_ID, static_cast<float>(qualityTier.load()));
+}
+
+void AnalogSaturationAudioProcessor::setMeterParameter (const char* parameterID, float value)
+{
+    // Only update listeners on changes of at least one display step. A meter
+    // reading is not an edit, so it is set directly instead of going through
+    // setValueNotifyingHost().
+    if (auto* parameter = parameters.getParameter (parameterID))
+    {
+        if (std::abs (parameter->convertFrom0to1 (parameter->getValue()) - value) >= 0.5f)
+        {
+            parameter->setValue (parameter->convertTo0to1 (value));
+            parameter->sendValueChangedMessageToListeners (parameter->getValue());
+        }
+    }
+}
+
+void AnalogSaturationAudioProcessor::removeMeterParameters (juce::ValueTree& state)
+{
+    for (auto* meterID : { CPU_LOAD_ID, QUALITY_TIER_ID })
+        state.removeChild (state.getChildWithProperty ("id", meterID), nullptr);
 }
 
 //==============================================================================
@@ -170,7 +318,9 @@ juce::AudioProcessorEditor* AnalogSaturationAudioProcessor::createEditor()
 //==============================================================================
 void AnalogSaturationAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
+    // The meters describe this session's load, not a setting to recall
     auto state = parameters.copyState();
+    removeMeterParameters (state);
     std::unique_ptr<juce::XmlElement> xml (state.createXml());
     copyXmlToBinary (*xml, destData);
 }
@@ -179,9 +329,16 @@ void AnalogSaturationAudioProcessor::setStateInformation (const void* data, int
 {
     std::unique_ptr<juce::XmlElement> xmlState (getXmlFromBinary (data, sizeInBytes));
 
+    // Sessions saved before the meters were left out may still carry them
     if (xmlState.get() != nullptr)
+    {
         if (xmlState->hasTagName (parameters.state.getType()))
-            parameters.replaceState (juce::ValueTree::fromXml (*xmlState));
+        {
+            auto state = juce::ValueTree::fromXml (*xmlState);
+            removeMeterParameters (state);
+            parameters.replaceState (state);
+        }
+    }
 }
 
 //==============================================================================
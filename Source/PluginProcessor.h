@@ -2,11 +2,14 @@
 
 #include <JuceHeader.h>
 #include "SaturationEngine.h"
+#include "QualityGovernor.h"
+#include "AnalysisFifo.h"
 
 //==============================================================================
 /**
 */
-class AnalogSaturationAudioProcessor  : public juce::AudioProcessor
+class AnalogSaturationAudioProcessor  : public juce::AudioProcessor,
+                                        private juce::Timer
 {
 public:
     //==============================================================================
@@ -22,6 +25,9 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+
+    bool supportsDoublePrecisionProcessing() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -48,10 +54,19 @@ public:
 
     //==============================================================================
     juce::AudioProcessorValueTreeState& getValueTreeState() { return parameters; }
+    
+    // Processing load as a proportion of real time, and the quality tier in use
+    float getCpuLoad() const { return cpuLoad.load(); }
+    int getQualityTier() const { return qualityTier.load(); }
+    
+    // Input and output frames for the editor's meters and displays
+    AnalysisFifo& getAnalysisFifo() { return analysisFifo; }
 
 private:
     //==============================================================================
-    SaturationEngine saturationEngine;
+    // One engine per host precision; only the one in use is prepared
+    SaturationEngine<float> floatEngine;
+    SaturationEngine<double> doubleEngine;
     
     juce::AudioProcessorValueTreeState parameters;
     
@@ -61,6 +76,53 @@ private:
     static constexpr const char* MIX_ID = "mix";
     static constexpr const char* CIRCUIT_TYPE_ID = "circuitType";
     static constexpr const char* MODEL_TYPE_ID = "modelType";
+    static constexpr const char* OVERSAMPLING_ID = "oversampling";
+    static constexpr const char* OVERSAMPLING_MODE_ID = "oversamplingMode";
+    static constexpr const char* ANTIALIASING_ID = "antialiasing";
+    static constexpr const char* AUTO_QUALITY_ID = "autoQuality";
+    static constexpr const char* CPU_BUDGET_ID = "cpuBudget";
+    static constexpr const char* CPU_LOAD_ID = "cpuLoad";
+    static constexpr const char* QUALITY_TIER_ID = "qualityTier";
+    
+    // Quality tiers below full quality: Hybrid runs as State-Space, then
+    // ADAA drops to first order, then each further tier halves oversampling
+    // (padded to the selected factor's latency)
+    static constexpr int numModelTiers = 2;
+    
+    template <typename SampleType>
+    void updateEngineParameters (SaturationEngine<SampleType>& engine);
+
+    template <typename SampleType>
+    void process (juce::AudioBuffer<SampleType>& buffer, SaturationEngine<SampleType>& engine);
+
+    template <typename SampleType>
+    void prepareEngine (SaturationEngine<SampleType>& engine, const juce::dsp::ProcessSpec& spec);
+    
+    // Measures processBlock against the block duration; the governor turns
+    // that into a quality tier when auto quality is on
+    juce::AudioProcessLoadMeasurer loadMeasurer;
+    QualityGovernor qualityGovernor;
+    
+    // Written on the audio thread, shown through the read-only parameters
+    std::atomic<float> cpuLoad { 0.0f };
+    std::atomic<int> qualityTier { 0 };
+    
+    void updateQualityTier (int numSamples);
+    void setMeterParameter (const char* parameterID, float value);
+    
+    // Drops the read-only meters from a saved or restored state
+    static void removeMeterParameters (juce::ValueTree& state);
+    
+    AnalysisFifo analysisFifo;
+    
+    // Written on the audio thread, read by the host from any thread
+    std::atomic<double> tailLengthSeconds { 0.0 };
+    
+    // Latency wanted by the audio thread. setLatencySamples() notifies
+    // listeners under a lock, so the timer reports it from the message thread.
+    std::atomic<int> pendingLatencySamples { 0 };
+    
+    void timerCallback() override;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalogSaturationAudioProcessor)
 };
@@ -0,0 +1,91 @@
+#include "QualityGovernor.h"
+
+namespace
+{
+    // Sample counters saturate well before they could overflow
+    constexpr int maximumCount = std::numeric_limits<int>::max() / 2;
+
+    int addSamples(int count, int numSamples)
+    {
+        return juce::jmin(count + numSamples, maximumCount);
+    }
+}
+
+void QualityGovernor::prepare(double sampleRate)
+{
+    stepDownSamples = juce::jmax(1, juce::roundToInt(sampleRate * stepDownSeconds));
+    stepUpSamples = juce::jmax(1, juce::roundToInt(sampleRate * stepUpSeconds));
+    reset();
+}
+
+void QualityGovernor::reset()
+{
+    tier = 0;
+    holdFactor = 1;
+    overBudgetSamples = 0;
+    underBudgetSamples = 0;
+    samplesSinceStepUp = maximumCount;
+}
+
+void QualityGovernor::setBudget(double proportion)
+{
+    budget = juce::jlimit(0.01, 1.0, proportion);
+}
+
+void QualityGovernor::setMaximumTier(int newMaximumTier)
+{
+    maximumTier = juce::jmax(0, newMaximumTier);
+    tier = juce::jmin(tier, maximumTier);
+}
+
+int QualityGovernor::update(double load, int numSamples)
+{
+    samplesSinceStepUp = addSamples(samplesSinceStepUp, numSamples);
+
+    // The last step up has held for as long as it had to wait: relax the
+    // wait again. The count is parked at its maximum once this is done, and
+    // whenever the tier steps down.
+    if (load <= budget && samplesSinceStepUp < maximumCount
+        && samplesSinceStepUp >= stepUpSamples * holdFactor)
+    {
+        holdFactor = juce::jmax(1, holdFactor / 2);
+        samplesSinceStepUp = maximumCount;
+    }
+
+    if (load > budget)
+    {
+        underBudgetSamples = 0;
+        overBudgetSamples = addSamples(overBudgetSamples, numSamples);
+
+        if (overBudgetSamples >= stepDownSamples && tier < maximumTier)
+        {
+            // The last step up did not fit: be slower to try it again
+            if (samplesSinceStepUp < stepUpSamples)
+                holdFactor = juce::jmin(holdFactor * 2, maximumHoldFactor);
+
+            // Nothing left to hold
+            ++tier;
+            overBudgetSamples = 0;
+            samplesSinceStepUp = maximumCount;
+        }
+    }
+    else if (load < budget * headroomRatio)
+    {
+        overBudgetSamples = 0;
+        underBudgetSamples = addSamples(underBudgetSamples, numSamples);
+
+        if (underBudgetSamples >= stepUpSamples * holdFactor && tier > 0)
+        {
+            --tier;
+            underBudgetSamples = 0;
+            samplesSinceStepUp = 0;
+        }
+    }
+    else
+    {
+        overBudgetSamples = 0;
+        underBudgetSamples = 0;
+    }
+
+    return tier;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * Chooses a quality tier from the measured processing load.
+ *
+ * Tier 0 is full quality and each higher tier is cheaper; what a tier means
+ * is up to the caller. update() is fed the load of every block as a
+ * proportion of the block's real-time duration. The tier steps down once
+ * the load has stayed above the budget for stepDownSeconds, and steps back
+ * up only after it has stayed well below the budget, at headroomRatio, for
+ * stepUpSeconds. A step up that pushes the load straight back over the
+ * budget doubles the wait before the next one, so a load sitting right at
+ * the edge does not flip between two tiers. A step up that stays within
+ * budget for that wait halves it again, so a few borderline steps early on
+ * do not slow every later recovery.
+ *
+ * Everything is plain arithmetic, safe to call on the audio thread.
+ */
+class QualityGovernor
+{
+public:
+    void prepare(double sampleRate);
+
+    // Back to full quality, forgetting any history
+    void reset();
+
+    void setBudget(double proportion);
+    void setMaximumTier(int tier);
+
+    // Account for one block and return the tier for the next one
+    int update(double load, int numSamples);
+
+    int getTier() const { return tier; }
+
+private:
+    static constexpr double stepDownSeconds = 0.25;
+    static constexpr double stepUpSeconds = 3.0;
+    static constexpr double headroomRatio = 0.5;
+    static constexpr int maximumHoldFactor = 8;
+
+    double budget = 0.5;
+    int maximumTier = 0;
+    int tier = 0;
+
+    int stepDownSamples = 1;
+    int stepUpSamples = 1;
+    int holdFactor = 1;
+
+    int overBudgetSamples = 0;
+    int underBudgetSamples = 0;
+    int samplesSinceStepUp = 0;
+};
@@ -1,65 +1,486 @@
 #include "SaturationEngine.h"
 
-SaturationEngine::SaturationEngine()
+template <typename SampleType>
+SaturationEngine<SampleType>::SaturationEngine()
 {
 }
 
-void SaturationEngine::prepare(const juce::dsp::ProcessSpec& spec)
+template <typename SampleType>
+void SaturationEngine<SampleType>::prepare(const juce::dsp::ProcessSpec& spec)
 {
     processSpec = spec;
-    circuitModels.prepare(spec.sampleRate);
+    
+    const int numChannels = juce::jmax(1, static_cast<int>(spec.numChannels));
+    const int numGroups = (numChannels + LaneMath::numLanes - 1) / LaneMath::numLanes;
+    const int maximumBlockSize = juce::jmax(1, static_cast<int>(spec.maximumBlockSize));
+    const int maximumOversampledBlockSize = maximumBlockSize << maxOversamplingStages;
+    
+    for (auto& path : paths)
+    {
+        for (int mode = 0; mode < numOversamplingModes; ++mode)
+        {
+            auto filterType = mode == 0 ? Oversampler::filterHalfBandPolyphaseIIR
+                                        : Oversampler::filterHalfBandFIREquiripple;
+            
+            for (int stages = 1; stages <= maxOversamplingStages; ++stages)
+            {
+                auto& oversampler = path.oversamplers[static_cast<size_t>(mode)]
+                                                     [static_cast<size_t>(stages - 1)];
+                oversampler = std::make_unique<Oversampler>(static_cast<size_t>(numChannels),
+                                                            static_cast<size_t>(stages),
+                                                            filterType, true, true);
+                oversampler->initProcessing(static_cast<size_t>(maximumBlockSize));
+            }
+        }
+    }
+    
+    int maximumLatency = 0;
+    for (int mode = 0; mode < numOversamplingModes; ++mode)
+        for (int factorIndex = 1; factorIndex <= maxOversamplingStages; ++factorIndex)
+            maximumLatency = juce::jmax(maximumLatency, getOversamplerLatency(factorIndex, mode));
+    
+    // Both paths start out at the current setting; the idle one is restarted
+    // whenever a switch hands it a new one
+    for (auto& path : paths)
+    {
+        path.oversamplingIndex = oversamplingIndex;
+        path.oversamplingMode = oversamplingMode;
+        path.latencyOversamplingIndex = latencyOversamplingIndex;
+        
+        path.latencyPadding.setMaximumDelayInSamples(maximumLatency);
+        path.latencyPadding.prepare({ spec.sampleRate, static_cast<juce::uint32>(maximumBlockSize),
+                                      static_cast<juce::uint32>(numChannels) });
+        updateLatencyPadding(path);
+        
+        path.laneGroups.resize(static_cast<size_t>(numGroups));
+        for (auto& group : path.laneGroups)
+        {
+            group.prepare(spec.sampleRate * (1 << path.oversamplingIndex), maximumOversampledBlockSize);
+        }
+    }
+    
+    activePath = 0;
+    crossfadeRemaining = 0;
+    crossfadeLength = juce::jmax(1, juce::roundToInt(spec.sampleRate * crossfadeTimeSeconds));
+    fadeBuffer.setSize(numChannels, maximumBlockSize);
+    
+    groupActivity.assign(static_cast<size_t>(numGroups), GroupActivity());
+    
+    laneBufferSize = maximumOversampledBlockSize;
+    laneBuffer.assign(static_cast<size_t>(numGroups * laneBufferSize), Lanes::expand(0.0));
+    
+    // The audio thread takes a share itself, so one worker fewer than groups
+    // is enough
+    const int numWorkers = useWorkerPool ? juce::jmin(numGroups - 1, juce::SystemStats::getNumCpus() - 1) : 0;
+    
+    if (numWorkers <= 0)
+        workerPool.reset();
+    else if (workerPool == nullptr || workerPool->getNumWorkers() != numWorkers)
+        workerPool = std::make_unique<WorkerPool>(numWorkers);
+}
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::reset()
+{
+    for (auto& path : paths)
+    {
+        for (auto& group : path.laneGroups)
+        {
+            group.reset();
+        }
+        
+        path.latencyPadding.reset();
+        
+        for (auto& modeOversamplers : path.oversamplers)
+        {
+            for (auto& oversampler : modeOversamplers)
+            {
+                if (oversampler != nullptr)
+                    oversampler->reset();
+            }
+        }
+    }
+    
+    std::fill(groupActivity.begin(), groupActivity.end(), GroupActivity());
+    crossfadeRemaining = 0;
+}
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::processBlock(juce::AudioBuffer<SampleType>& buffer)
+{
+    // A new oversampling setting starts on the idle path. Changes made during
+    // a crossfade are picked up once it finishes.
+    if (crossfadeRemaining == 0 && isOversamplingChangePending())
+        startOversamplingChange();
+    
+    // Silent, settled input needs no processing at all, and nothing sounds
+    // that a switch could cut off
+    if (! updateGroupActivity(buffer))
+    {
+        crossfadeRemaining = 0;
+        return;
+    }
+    
+    const int numSamples = buffer.getNumSamples();
+    juce::dsp::AudioBlock<SampleType> block(buffer);
+    juce::dsp::AudioBlock<SampleType> fadeBlock;
+    
+    // The old path runs on a copy of the input alongside the new one
+    if (crossfadeRemaining > 0)
+    {
+        const auto numChannels = juce::jmin(block.getNumChannels(), static_cast<size_t>(fadeBuffer.getNumChannels()));
+        fadeBlock = juce::dsp::AudioBlock<SampleType>(fadeBuffer).getSubsetChannelBlock(0, numChannels)
+                                                                 .getSubBlock(0, static_cast<size_t>(numSamples));
+        fadeBlock.copyFrom(block);
+        processPath(paths[static_cast<size_t>(1 - activePath)], fadeBlock);
+    }
+    
+    processPath(paths[static_cast<size_t>(activePath)], block);
+    
+    if (crossfadeRemaining > 0)
+    {
+        // Only the old path sounds until the new one's filters have filled,
+        // then the two are crossfaded linearly
+        const SampleType step = SampleType(1) / static_cast<SampleType>(crossfadeLength);
+        
+        for (size_t channel = 0; channel < fadeBlock.getNumChannels(); ++channel)
+        {
+            SampleType* output = block.getChannelPointer(channel);
+            const SampleType* faded = fadeBlock.getChannelPointer(channel);
+            
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const SampleType fadeOut = static_cast<SampleType>(juce::jlimit(0, crossfadeLength, crossfadeRemaining - i)) * step;
+                output[i] = output[i] * (SampleType(1) - fadeOut) + faded[i] * fadeOut;
+            }
+        }
+        
+        crossfadeRemaining = juce::jmax(0, crossfadeRemaining - numSamples);
+    }
+    
+    sleepSettledGroups(buffer);
+}
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::processPath(Path& path, juce::dsp::AudioBlock<SampleType>& block)
+{
+    auto* oversampler = getOversampler(path, path.oversamplingIndex, path.oversamplingMode);
+    
+    if (oversampler == nullptr)
+    {
+        processLaneGroups(path, block);
+    }
+    else
+    {
+        auto oversampledBlock = oversampler->processSamplesUp(block);
+        processLaneGroups(path, oversampledBlock);
+        oversampler->processSamplesDown(block);
+    }
+    
+    if (path.latencyPaddingSamples > 0)
+    {
+        auto channels = block.getSubsetChannelBlock(0, juce::jmin(block.getNumChannels(),
+                                                                  static_cast<size_t>(processSpec.numChannels)));
+        path.latencyPadding.process(juce::dsp::ProcessContextReplacing<SampleType>(channels));
+    }
+}
+
+template <typename SampleType>
+SampleType SaturationEngine<SampleType>::getGroupMagnitude(const juce::AudioBuffer<SampleType>& buffer, size_t group) const
+{
+    const int firstChannel = static_cast<int>(group) * LaneMath::numLanes;
+    const int lastChannel = juce::jmin(firstChannel + LaneMath::numLanes, buffer.getNumChannels());
+    
+    SampleType magnitude = 0;
+    for (int channel = firstChannel; channel < lastChannel; ++channel)
+    {
+        magnitude = juce::jmax(magnitude, buffer.getMagnitude(channel, 0, buffer.getNumSamples()));
+    }
+    
+    return magnitude;
+}
+
+template <typename SampleType>
+bool SaturationEngine<SampleType>::updateGroupActivity(const juce::AudioBuffer<SampleType>& buffer)
+{
+    bool anyAwake = false;
+    
+    for (size_t group = 0; group < groupActivity.size(); ++group)
+    {
+        auto& activity = groupActivity[group];
+        
+        if (getGroupMagnitude(buffer, group) >= silenceThreshold)
+        {
+            // The state was cleared on sleeping, so processing resumes exactly
+            // as a settled model would
+            activity.silentSamples = 0;
+            activity.sleeping = false;
+        }
+        else if (! activity.sleeping)
+        {
+            activity.silentSamples = juce::jmin(activity.silentSamples + buffer.getNumSamples(),
+                                                std::numeric_limits<int>::max() / 2);
+        }
+        
+        anyAwake = anyAwake || ! activity.sleeping;
+    }
+    
+    return anyAwake;
+}
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::sleepSettledGroups(const juce::AudioBuffer<SampleType>& buffer)
+{
+    const int tailSamples = juce::roundToInt(getTailLengthSeconds() * processSpec.sampleRate);
+    
+    for (size_t group = 0; group < groupActivity.size(); ++group)
+    {
+        auto& activity = groupActivity[group];
+        
+        // The input has been silent for the whole tail and the state has
+        // decayed below the threshold
+        if (! activity.sleeping && activity.silentSamples >= tailSamples
+            && getGroupMagnitude(buffer, group) < silenceThreshold)
+        {
+            activity.sleeping = true;
+            
+            for (auto& path : paths)
+                path.laneGroups[group].reset();
+        }
+    }
 }
 
-void SaturationEngine::reset()
+template <typename SampleType>
+void SaturationEngine<SampleType>::processLaneGroups(Path& path, juce::dsp::AudioBlock<SampleType>& block)
 {
-    circuitModels.reset();
+    const int numGroups = static_cast<int>(path.laneGroups.size());
+    const int load = static_cast<int>(block.getNumChannels()) << path.oversamplingIndex;
+    
+    if (workerPool != nullptr && numGroups > 1 && load >= parallelLoadThreshold)
+    {
+        // Groups share nothing but read-only tables, so they need no locking
+        auto processGroup = [this, &path, &block](int group) { processLaneGroup(path, block, static_cast<size_t>(group)); };
+        workerPool->run(numGroups, processGroup);
+    }
+    else
+    {
+        for (size_t group = 0; group < path.laneGroups.size(); ++group)
+        {
+            processLaneGroup(path, block, group);
+        }
+    }
 }
 
-void SaturationEngine::processBlock(juce::AudioBuffer<float>& buffer)
+template <typename SampleType>
+void SaturationEngine<SampleType>::processLaneGroup(Path& path, juce::dsp::AudioBlock<SampleType>& block, size_t group)
 {
-    auto numChannels = buffer.getNumChannels();
-    auto numSamples = buffer.getNumSamples();
+    if (groupActivity[group].sleeping)
+        return;
+    
+    const int numChannels = juce::jmin(static_cast<int>(block.getNumChannels()),
+                                       static_cast<int>(path.laneGroups.size()) * LaneMath::numLanes);
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    const int chunkSize = laneBufferSize;
+    
+    const int firstChannel = static_cast<int>(group) * LaneMath::numLanes;
+    const int groupChannels = juce::jmin(LaneMath::numLanes, numChannels - firstChannel);
+    
+    if (groupChannels <= 0)
+        return;
+    
+    auto& models = path.laneGroups[group];
+    Lanes* lanes = laneBuffer.data() + group * static_cast<size_t>(laneBufferSize);
     
     // Update parameters
-    circuitModels.setDrive(static_cast<double>(drive));
-    circuitModels.setTone(static_cast<double>(tone));
-    circuitModels.setMix(static_cast<double>(mix));
-    circuitModels.setCircuitType(circuitType);
-    circuitModels.setModelType(static_cast<CircuitModels::ModelType>(modelType));
+    models.setDrive(static_cast<double>(drive));
+    models.setTone(static_cast<double>(tone));
+    models.setMix(static_cast<double>(mix));
+    models.setCircuitType(circuitType);
+    models.setModelType(static_cast<CircuitModels::ModelType>(modelType));
+    models.setAntialiasingMode(static_cast<AntialiasingMode>(antialiasing));
+    models.setUseLookupTables(useLookupTables);
     
-    // Process each sample
-    for (int channel = 0; channel < numChannels; ++channel)
+    // Process every channel of the group in one pass
+    for (int offset = 0; offset < numSamples; offset += chunkSize)
     {
-        auto* channelData = buffer.getWritePointer(channel);
+        const int chunk = juce::jmin(chunkSize, numSamples - offset);
         
-        for (int sample = 0; sample < numSamples; ++sample)
+        SampleType* groupPointers[LaneMath::numLanes] = {};
+        for (int channel = 0; channel < groupChannels; ++channel)
         {
-            channelData[sample] = circuitModels.processSample(channelData[sample]);
+            auto channelIndex = static_cast<size_t>(firstChannel + channel);
+            groupPointers[channel] = block.getChannelPointer(channelIndex) + offset;
         }
+        
+        LaneMath::interleave(groupPointers, groupChannels, lanes, chunk);
+        models.processBlock(lanes, lanes, chunk);
+        LaneMath::deinterleave(lanes, groupPointers, groupChannels, chunk);
+    }
+}
+
+template <typename SampleType>
+typename SaturationEngine<SampleType>::Oversampler* SaturationEngine<SampleType>::getOversampler(const Path& path, int factorIndex, int mode) const
+{
+    if (factorIndex <= 0)
+        return nullptr;
+    
+    return path.oversamplers[static_cast<size_t>(mode)][static_cast<size_t>(factorIndex - 1)].get();
+}
+
+template <typename SampleType>
+bool SaturationEngine<SampleType>::isOversamplingChangePending() const
+{
+    const auto& path = paths[static_cast<size_t>(activePath)];
+    
+    return oversamplingIndex != path.oversamplingIndex
+           || oversamplingMode != path.oversamplingMode
+           || latencyOversamplingIndex != path.latencyOversamplingIndex;
+}
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::startOversamplingChange()
+{
+    // The old path keeps its state and fades out; the new one starts cold
+    activePath = 1 - activePath;
+    auto& path = paths[static_cast<size_t>(activePath)];
+    
+    path.oversamplingIndex = oversamplingIndex;
+    path.oversamplingMode = oversamplingMode;
+    path.latencyOversamplingIndex = latencyOversamplingIndex;
+    
+    // The models run at the oversampled rate, so this re-derives their
+    // coefficients and clears their state; buffers were sized for the
+    // largest factor in prepare()
+    for (auto& group : path.laneGroups)
+    {
+        group.setSampleRate(processSpec.sampleRate * (1 << path.oversamplingIndex));
     }
+    
+    if (auto* oversampler = getOversampler(path, path.oversamplingIndex, path.oversamplingMode))
+        oversampler->reset();
+    
+    updateLatencyPadding(path);
+    
+    // Until its latency has passed, the new path only outputs its filters
+    // filling up, so the crossfade waits for that
+    crossfadeRemaining = getLatencySamples() + crossfadeLength;
+}
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::updateLatencyPadding(Path& path)
+{
+    path.latencyPaddingSamples = juce::jmax(0, getOversamplerLatency(path.latencyOversamplingIndex, path.oversamplingMode)
+                                               - getOversamplerLatency(path.oversamplingIndex, path.oversamplingMode));
+    path.latencyPadding.reset();
+    path.latencyPadding.setDelay(static_cast<SampleType>(path.latencyPaddingSamples));
+}
+
+template <typename SampleType>
+int SaturationEngine<SampleType>::getOversamplerLatency(int factorIndex, int mode) const
+{
+    // Both paths hold the same set of filters
+    if (auto* oversampler = getOversampler(paths[0], factorIndex, mode))
+        return juce::roundToInt(oversampler->getLatencyInSamples());
+    
+    return 0;
+}
+
+template <typename SampleType>
+int SaturationEngine<SampleType>::getLatencySamples() const
+{
+    return juce::jmax(getOversamplerLatency(oversamplingIndex, oversamplingMode),
+                      getOversamplerLatency(latencyOversamplingIndex, oversamplingMode));
+}
+
+template <typename SampleType>
+double SaturationEngine<SampleType>::getTailLengthSeconds() const
+{
+    if (processSpec.sampleRate <= 0.0)
+        return 0.0;
+    
+    // The slowest decay in the models is the tone one-pole (pole 1 - tone,
+    // feeding at most 0.3 * tone of its state to the output) at the model rate
+    const double modelRate = processSpec.sampleRate * (1 << oversamplingIndex);
+    const double toneValue = static_cast<double>(tone);
+    const double initialLevel = 0.3 * toneValue;
+    double toneSamples = 0.0;
+    
+    if (toneValue > 0.0 && toneValue < 1.0 && initialLevel > silenceThreshold)
+        toneSamples = std::log(silenceThreshold / initialLevel) / std::log(1.0 - toneValue);
+    
+    // The circuit RC networks settle within a millisecond; the oversampling
+    // filters add their delay plus a comparable ring-out
+    const double circuitSeconds = 0.001;
+    const double filterSeconds = 2.0 * getLatencySamples() / processSpec.sampleRate;
+    
+    return toneSamples / modelRate + circuitSeconds + filterSeconds;
 }
 
-void SaturationEngine::setDrive(float drive)
+template <typename SampleType>
+void SaturationEngine<SampleType>::setDrive(float drive)
 {
     this->drive = juce::jlimit(0.0f, 1.0f, drive);
 }
 
-void SaturationEngine::setTone(float tone)
+template <typename SampleType>
+void SaturationEngine<SampleType>::setTone(float tone)
 {
     this->tone = juce::jlimit(0.0f, 1.0f, tone);
 }
 
-void SaturationEngine::setMix(float mix)
+template <typename SampleType>
+void SaturationEngine<SampleType>::setMix(float mix)
 {
     this->mix = juce::jlimit(0.0f, 1.0f, mix);
 }
 
-void SaturationEngine::setCircuitType(int type)
+template <typename SampleType>
+void SaturationEngine<SampleType>::setCircuitType(int type)
 {
     this->circuitType = juce::jlimit(0, 3, type);
 }
 
-void SaturationEngine::setModelType(int type)
+template <typename SampleType>
+void SaturationEngine<SampleType>::setModelType(int type)
 {
     this->modelType = juce::jlimit(0, 2, type);
 }
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::setOversampling(int factorIndex)
+{
+    this->oversamplingIndex = juce::jlimit(0, maxOversamplingStages, factorIndex);
+}
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::setOversamplingMode(int mode)
+{
+    this->oversamplingMode = juce::jlimit(0, numOversamplingModes - 1, mode);
+}
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::setLatencyOversampling(int factorIndex)
+{
+    this->latencyOversamplingIndex = juce::jlimit(0, maxOversamplingStages, factorIndex);
+}
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::setAntialiasing(int mode)
+{
+    this->antialiasing = juce::jlimit(0, 2, mode);
+}
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::setUseLookupTables(bool shouldUseTables)
+{
+    this->useLookupTables = shouldUseTables;
+}
+
+template <typename SampleType>
+void SaturationEngine<SampleType>::setUseWorkerPool(bool shouldUsePool)
+{
+    this->useWorkerPool = shouldUsePool;
+}
+
+template class SaturationEngine<float>;
+template class SaturationEngine<double>;
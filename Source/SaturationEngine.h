@@ -2,10 +2,44 @@
 
 #include <JuceHeader.h>
 #include "CircuitModels.h"
+#include "WorkerPool.h"
+#include <array>
+#include <memory>
+#include <vector>
 
 /**
  * Main saturation engine that manages the DSP processing.
+ *
+ * Channels are packed into SIMD lanes, LaneMath::numLanes at a time. Each
+ * lane group owns its own CircuitModels, so filter state never leaks
+ * between channels and a stereo pair is computed in a single pass.
+ *
+ * The models can optionally run inside a 2x/4x/8x oversampling stage built
+ * from cascaded polyphase halfband filters, either minimum phase (IIR) or
+ * linear phase (FIR). setLatencyOversampling() lets a lower factor run at
+ * the latency of a higher one, padded with a delay.
+ *
+ * Oversamplers, models and padding make up a processing path, and there are
+ * two of them. A new factor or mode starts on the idle path while the old
+ * one keeps running. The new path is held silent until its filters have
+ * filled, then crossfaded in; both are aligned by the padding, so the output
+ * never ramps through silence.
+ *
+ * Any channel count is supported. When the channel count times the
+ * oversampling factor reaches parallelLoadThreshold, the lane groups are
+ * split across a worker pool built in prepare(); smaller loads stay on the
+ * audio thread.
+ *
+ * Lane groups whose input has been silent for longer than the tail, and
+ * whose output has decayed below the silence threshold, go to sleep: their
+ * state is cleared and they are skipped until signal returns. When every
+ * group sleeps the whole block, oversampling included, is left untouched.
+ *
+ * The engine is templated on the host sample type (float or double) so that
+ * buffers are processed in place at either precision. The models themselves
+ * always compute in double.
  */
+template <typename SampleType>
 class SaturationEngine
 {
 public:
@@ -15,16 +49,95 @@ public:
     void prepare(const juce::dsp::ProcessSpec& spec);
     void reset();
     
-    void processBlock(juce::AudioBuffer<float>& buffer);
+    void processBlock(juce::AudioBuffer<SampleType>& buffer);
     
     void setDrive(float drive);
     void setTone(float tone);
     void setMix(float mix);
     void setCircuitType(int type);
     void setModelType(int type);
+    void setOversampling(int factorIndex);  // 0 = 1x, 1 = 2x, 2 = 4x, 3 = 8x
+    void setOversamplingMode(int mode);     // 0 = minimum phase, 1 = linear phase
+    
+    // Keep the latency of this factor while a lower one runs, delaying the
+    // output to match, so that stepping the factor down to save CPU does not
+    // move the host's delay compensation. 0 (the default) pads nothing.
+    void setLatencyOversampling(int factorIndex);
+    void setAntialiasing(int mode);         // 0 = off, 1 = first-order ADAA, 2 = second-order ADAA
+    void setUseLookupTables(bool shouldUseTables);  // Table-driven nonlinearities (default) or exact
+    void setUseWorkerPool(bool shouldUsePool);      // Takes effect on the next prepare()
+    
+    // Latency introduced by the current oversampling setting, padding included
+    int getLatencySamples() const;
+    
+    // Time for the output to decay below the silence threshold once the
+    // input stops, for the current tone and oversampling settings
+    double getTailLengthSeconds() const;
     
 private:
-    CircuitModels circuitModels;
+    using Lanes = LaneMath::Lanes;
+    using Oversampler = juce::dsp::Oversampling<SampleType>;
+    
+    static constexpr int maxOversamplingStages = 3;
+    static constexpr int numOversamplingModes = 2;
+    
+    // Everything that depends on the oversampling setting, prepared for one
+    struct Path
+    {
+        int oversamplingIndex = 0;
+        int oversamplingMode = 0;
+        int latencyOversamplingIndex = 0;
+        
+        // One oversampler per (mode, stage count), built in prepare() so that
+        // switching factor never allocates on the audio thread
+        std::array<std::array<std::unique_ptr<Oversampler>, maxOversamplingStages>,
+                   numOversamplingModes> oversamplers;
+        
+        // Pads a lower factor's output to the latency of latencyOversamplingIndex;
+        // sized in prepare() for the longest latency of any factor
+        juce::dsp::DelayLine<SampleType, juce::dsp::DelayLineInterpolationTypes::None> latencyPadding;
+        int latencyPaddingSamples = 0;
+        
+        // One model per group of numLanes channels
+        std::vector<CircuitModels> laneGroups;
+    };
+    
+    // The active path, and the one fading out after an oversampling switch
+    std::array<Path, 2> paths;
+    int activePath = 0;
+    
+    // The old path runs until the new one's latency has passed, then for the
+    // crossfade; crossfadeRemaining counts both
+    static constexpr double crossfadeTimeSeconds = 0.01;
+    int crossfadeLength = 1;
+    int crossfadeRemaining = 0;
+    
+    // Input copy for the fading path, sized in prepare()
+    juce::AudioBuffer<SampleType> fadeBuffer;
+    
+    // Silence tracking per lane group
+    struct GroupActivity
+    {
+        int silentSamples = 0;  // Consecutive input samples below the threshold
+        bool sleeping = false;
+    };
+    
+    std::vector<GroupActivity> groupActivity;
+    
+    // Channels times oversampling factor from which lane groups run in parallel
+    static constexpr int parallelLoadThreshold = 16;
+    
+    // Helper threads for large channel counts; null when not worth it
+    std::unique_ptr<WorkerPool> workerPool;
+    bool useWorkerPool = true;
+    
+    static constexpr SampleType silenceThreshold = static_cast<SampleType>(1.0e-6);  // -120 dB
+    
+    // Interleaved scratch, one slice of laneBufferSize per lane group so that
+    // groups can run concurrently; sized in prepare()
+    std::vector<Lanes> laneBuffer;
+    int laneBufferSize = 0;
+    
     juce::dsp::ProcessSpec processSpec;
     
     float drive = 0.5f;
@@ -32,4 +145,25 @@ private:
     float mix = 1.0f;
     int circuitType = 0;
     int modelType = 2;  // Default to Hybrid
+    int oversamplingIndex = 0;
+    int oversamplingMode = 0;
+    int latencyOversamplingIndex = 0;
+    int antialiasing = 0;
+    bool useLookupTables = true;
+    
+    Oversampler* getOversampler(const Path& path, int factorIndex, int mode) const;
+    int getOversamplerLatency(int factorIndex, int mode) const;
+    bool isOversamplingChangePending() const;
+    void startOversamplingChange();
+    void updateLatencyPadding(Path& path);
+    void processPath(Path& path, juce::dsp::AudioBlock<SampleType>& block);
+    void processLaneGroups(Path& path, juce::dsp::AudioBlock<SampleType>& block);
+    void processLaneGroup(Path& path, juce::dsp::AudioBlock<SampleType>& block, size_t group);
+    
+    // Peak level of a lane group's channels over the buffer
+    SampleType getGroupMagnitude(const juce::AudioBuffer<SampleType>& buffer, size_t group) const;
+    
+    // Wake groups with input, returns true if any group needs processing
+    bool updateGroupActivity(const juce::AudioBuffer<SampleType>& buffer);
+    void sleepSettledGroups(const juce::AudioBuffer<SampleType>& buffer);
 };
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "WakeSignal.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Process-wide registry of immutable DSP resources (tables, kernels,
+ * coefficient sets) shared by every plugin instance in the process.
+ *
+ * A resource is identified by a Key that fully determines its contents, so
+ * every instance asking for the same key gets the same copy. Instances reach
+ * the registry through juce::SharedResourcePointer, which creates it with the
+ * first instance and destroys it with the last. Each resource is reference
+ * counted by the slots holding it and freed when the last one lets go.
+ *
+ * Each consumer owns a Slot. The audio thread posts the key it needs with
+ * request() and picks the resource up with get() once the registry's builder
+ * thread has found or built it; until then the consumer falls back to a
+ * slower path. Neither call allocates, locks or waits. The builder publishes
+ * a resource with a single atomic store, and the slot's reader announces the
+ * resource it is using (a hazard pointer), so a replaced resource is only
+ * released, on the builder thread, once the reader has moved on.
+ *
+ * Key must be copyable and comparable with ==. Resource must be default
+ * constructible; the build function fills it in.
+ */
+template <typename Key, typename Resource>
+class SharedResourceRegistry
+{
+    struct Entry
+    {
+        Key key;
+        Resource resource;
+    };
+
+public:
+    using BuildFunction = void (*)(const Key& key, Resource& resource);
+
+    SharedResourceRegistry(const char* threadName, BuildFunction buildFunction)
+        : build(buildFunction),
+          builder(*this, threadName)
+    {
+        builder.startThread(juce::Thread::Priority::low);
+    }
+
+    ~SharedResourceRegistry()
+    {
+        // Every slot keeps its registry alive through its owner
+        jassert (slots.empty());
+
+        builder.signalThreadShouldExit();
+        wakeSignal.notify();
+        builder.stopThread(1000);
+    }
+
+    //==============================================================================
+    class Slot
+    {
+    public:
+        explicit Slot(SharedResourceRegistry& owner)
+            : registry(owner)
+        {
+            const std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.slots.push_back(this);
+        }
+
+        ~Slot()
+        {
+            const std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.slots.erase(std::find(registry.slots.begin(), registry.slots.end(), this));
+        }
+
+        // Audio thread: ask for the resource for key. Returns at once; only
+        // the most recent request is served.
+        void request(const Key& key)
+        {
+            requests.write(key);
+            registry.wakeSignal.notify();
+        }
+
+        // Off the audio thread: find or build the resource for key now and
+        // publish it, so the audio thread starts with it in place
+        void fetch(const Key& key)
+        {
+            const std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.publish(*this, key);
+        }
+
+        // Audio thread: the resource for key, or nullptr while it is not
+        // available yet. The pointer stays valid until the next call.
+        const Resource* get(const Key& key)
+        {
+            const Entry* entry = published.load();
+
+            // Announce the entry, then check it was not replaced meanwhile
+            for (;;)
+            {
+                reading.store(entry);
+                const Entry* latest = published.load();
+
+                if (latest == entry)
+                    break;
+
+                entry = latest;
+            }
+
+            return entry != nullptr && entry->key == key ? &entry->resource : nullptr;
+        }
+
+    private:
+        friend class SharedResourceRegistry;
+
+        SharedResourceRegistry& registry;
+
+        // Single-producer, single-consumer mailbox that keeps only the latest
+        // key: a triple buffer whose middle index carries a new-data flag
+        class Mailbox
+        {
+        public:
+            void write(const Key& key)
+            {
+                keys[static_cast<size_t>(back)] = key;
+                back = middle.exchange(back | newData, std::memory_order_acq_rel) & indexMask;
+            }
+
+            bool read(Key& key)
+            {
+                if ((middle.load(std::memory_order_relaxed) & newData) == 0)
+                    return false;
+
+                front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+                key = keys[static_cast<size_t>(front)];
+                return true;
+            }
+
+        private:
+            static constexpr int indexMask = 3;
+            static constexpr int newData = 4;
+
+            std::array<Key, 3> keys {};
+            std::atomic<int> middle { 1 };
+            int back = 0;   // writer only
+            int front = 2;  // reader only
+        };
+
+        Mailbox requests;
+
+        // The latest entry handed to this slot, and the one its reader uses
+        std::atomic<const Entry*> published { nullptr };
+        std::atomic<const Entry*> reading { nullptr };
+
+        // Under the registry lock: the references keeping those two alive
+        std::vector<std::shared_ptr<const Entry>> held;
+
+        JUCE_DECLARE_NON_COPYABLE (Slot)
+    };
+
+private:
+    class Builder : public juce::Thread
+    {
+    public:
+        Builder(SharedResourceRegistry& owner, const char* threadName)
+            : juce::Thread(threadName),
+              registry(owner)
+        {
+        }
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                registry.wakeSignal.wait();
+                registry.serviceRequests();
+            }
+        }
+
+    private:
+        SharedResourceRegistry& registry;
+    };
+
+    BuildFunction build;
+
+    // Guards everything below; never taken on the audio thread
+    std::mutex mutex;
+    std::vector<Slot*> slots;
+    std::vector<std::weak_ptr<const Entry>> entries;
+
+    WakeSignal wakeSignal;
+    Builder builder;
+
+    void serviceRequests()
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+
+        for (auto* slot : slots)
+        {
+            Key key;
+
+            if (slot->requests.read(key))
+                publish(*slot, key);
+            else
+                release(*slot);
+        }
+
+        // Forget resources nobody holds any more
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [](const auto& entry) { return entry.expired(); }),
+                      entries.end());
+    }
+
+    void publish(Slot& slot, const Key& key)
+    {
+        std::shared_ptr<const Entry> entry;
+
+        for (const auto& candidate : entries)
+        {
+            if (auto existing = candidate.lock(); existing != nullptr && existing->key == key)
+            {
+                entry = std::move(existing);
+                break;
+            }
+        }
+
+        if (entry == nullptr)
+        {
+            auto newEntry = std::make_shared<Entry>();
+            newEntry->key = key;
+            build(key, newEntry->resource);
+
+            entries.push_back(newEntry);
+            entry = std::move(newEntry);
+        }
+
+        slot.held.push_back(entry);
+        slot.published.store(entry.get());
+        release(slot);
+    }
+
+    // Drop the slot's references to entries its reader can no longer reach
+    static void release(Slot& slot)
+    {
+        const Entry* published = slot.published.load();
+        const Entry* reading = slot.reading.load();
+
+        slot.held.erase(std::remove_if(slot.held.begin(), slot.held.end(),
+                                       [published, reading](const auto& entry)
+                                       {
+                                           return entry.get() != published && entry.get() != reading;
+                                       }),
+                        slot.held.end());
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (SharedResourceRegistry)
+};
@@ -0,0 +1,329 @@
+#include <JuceHeader.h>
+#include "../SaturationEngine.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/**
+ * Microbenchmarks for the DSP models and the full engine.
+ *
+ *     AnalogSaturationBenchmark [--quick] [--filter <text>] [--json <file>]
+ *
+ * Every case is measured for each combination of sample rate, block size
+ * and channel count. Lane models (WaveDigitalFilter, NonlinearStateSpace,
+ * CircuitModels) run one instance per group of LaneMath::numLanes channels,
+ * as SaturationEngine does. The engine runs single-threaded so that results
+ * are comparable between machines with different core counts.
+ *
+ * Results are printed as a table, and optionally written as JSON for
+ * tracking regressions between releases.
+ */
+namespace
+{
+    using Lanes = LaneMath::Lanes;
+
+    // Test signal: a 110 Hz sine at -6 dBFS with a little noise, loud enough
+    // to drive every nonlinearity and never trigger silence skipping
+    double testSignal(int channel, int index, double sampleRate, juce::Random& random)
+    {
+        const double phase = juce::MathConstants<double>::twoPi * 110.0 * index / sampleRate;
+        return 0.5 * std::sin(phase + 0.5 * channel) + 0.01 * (random.nextDouble() - 0.5);
+    }
+
+    class Subject
+    {
+    public:
+        virtual ~Subject() = default;
+        virtual void prepare(double sampleRate, int blockSize, int numChannels) = 0;
+        virtual void process(int numSamples) = 0;
+    };
+
+    // A lane model run over as many lane groups as the channel count needs
+    template <typename Model>
+    class LaneSubject : public Subject
+    {
+    public:
+        using Setup = std::function<void(Model&, double sampleRate, int blockSize)>;
+
+        explicit LaneSubject(Setup setupToUse) : setup(std::move(setupToUse)) {}
+
+        void prepare(double sampleRate, int blockSize, int numChannels) override
+        {
+            models = std::vector<Model>(static_cast<size_t>((numChannels + LaneMath::numLanes - 1) / LaneMath::numLanes));
+
+            for (auto& model : models)
+            {
+                setup(model, sampleRate, blockSize);
+            }
+
+            juce::Random random(1);
+            input.resize(static_cast<size_t>(blockSize));
+            output.resize(static_cast<size_t>(blockSize));
+
+            for (int i = 0; i < blockSize; ++i)
+            {
+                Lanes frame;
+
+                for (size_t lane = 0; lane < Lanes::SIZE; ++lane)
+                    frame.set(lane, testSignal(static_cast<int>(lane), i, sampleRate, random));
+
+                input[static_cast<size_t>(i)] = frame;
+            }
+        }
+
+        void process(int numSamples) override
+        {
+            for (auto& model : models)
+            {
+                model.processBlock(input.data(), output.data(), numSamples);
+            }
+        }
+
+    private:
+        Setup setup;
+        std::vector<Model> models;
+        std::vector<Lanes> input, output;
+    };
+
+    class EngineSubject : public Subject
+    {
+    public:
+        explicit EngineSubject(int oversamplingIndex) : oversampling(oversamplingIndex) {}
+
+        void prepare(double sampleRate, int blockSize, int numChannels) override
+        {
+            engine = std::make_unique<SaturationEngine<float>>();
+            engine->setUseWorkerPool(false);
+            engine->setOversampling(oversampling);
+            engine->prepare({ sampleRate, static_cast<juce::uint32>(blockSize), static_cast<juce::uint32>(numChannels) });
+
+            juce::Random random(1);
+            source.setSize(numChannels, blockSize);
+            buffer.setSize(numChannels, blockSize);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                for (int i = 0; i < blockSize; ++i)
+                    source.setSample(channel, i, static_cast<float>(testSignal(channel, i, sampleRate, random)));
+        }
+
+        void process(int numSamples) override
+        {
+            // The engine works in place, so each block starts from the test signal
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                buffer.copyFrom(channel, 0, source, channel, 0, numSamples);
+
+            engine->processBlock(buffer);
+        }
+
+    private:
+        int oversampling;
+        std::unique_ptr<SaturationEngine<float>> engine;
+        juce::AudioBuffer<float> source, buffer;
+    };
+
+    //==============================================================================
+    struct Case
+    {
+        juce::String name;
+        std::function<std::unique_ptr<Subject>()> create;
+    };
+
+    std::vector<Case> makeCases()
+    {
+        using CircuitType = NonlinearStateSpace::CircuitType;
+        using ModelType = CircuitModels::ModelType;
+
+        std::vector<Case> cases;
+
+        cases.push_back({ "WaveDigitalFilter", []
+        {
+            return std::make_unique<LaneSubject<WaveDigitalFilter>>([](WaveDigitalFilter& wdf, double sampleRate, int)
+            {
+                wdf.setNonlinearity(0.7);
+                wdf.prepare(sampleRate);
+            });
+        } });
+
+        const std::pair<const char*, CircuitType> circuits[] = {
+            { "TubeTriode", CircuitType::TubeTriode },
+            { "TransistorBJT", CircuitType::TransistorBJT },
+            { "DiodeClipper", CircuitType::DiodeClipper },
+            { "OpAmpSaturation", CircuitType::OpAmpSaturation }
+        };
+
+        for (const auto& [circuitName, circuit] : circuits)
+        {
+            const auto type = circuit;
+
+            cases.push_back({ juce::String("NonlinearStateSpace/") + circuitName, [type]
+            {
+                return std::make_unique<LaneSubject<NonlinearStateSpace>>([type](NonlinearStateSpace& model, double sampleRate, int)
+                {
+                    model.setCircuitType(type);
+                    model.setDrive(2.0);
+                    model.prepare(sampleRate);
+                });
+            } });
+        }
+
+        const std::pair<const char*, ModelType> models[] = {
+            { "WDFBased", ModelType::WDFBased },
+            { "StateSpace", ModelType::StateSpace },
+            { "Hybrid", ModelType::Hybrid }
+        };
+
+        for (const auto& [modelName, model] : models)
+        {
+            const auto type = model;
+
+            cases.push_back({ juce::String("CircuitModels/") + modelName, [type]
+            {
+                return std::make_unique<LaneSubject<CircuitModels>>([type](CircuitModels& circuitModels, double sampleRate, int blockSize)
+                {
+                    circuitModels.setModelType(type);
+                    circuitModels.setDrive(0.7);
+                    circuitModels.prepare(sampleRate, blockSize);
+                });
+            } });
+        }
+
+        cases.push_back({ "SaturationEngine/1x", [] { return std::make_unique<EngineSubject>(0); } });
+        cases.push_back({ "SaturationEngine/4x", [] { return std::make_unique<EngineSubject>(2); } });
+
+        return cases;
+    }
+
+    struct Measurement
+    {
+        double nanosecondsPerSample;  // Per channel
+        double realtimeFactor;
+    };
+
+    // Median of several timed runs, each covering runSeconds of audio
+    Measurement measure(Subject& subject, double sampleRate, int blockSize, int numChannels,
+                        double runSeconds, int numRuns)
+    {
+        subject.prepare(sampleRate, blockSize, numChannels);
+
+        const int blocksPerRun = juce::jmax(1, juce::roundToInt(runSeconds * sampleRate / blockSize));
+
+        // Warm up caches, tables and branch predictors
+        for (int block = 0; block < juce::jmax(1, blocksPerRun / 4); ++block)
+            subject.process(blockSize);
+
+        std::vector<double> runTimes;
+
+        for (int run = 0; run < numRuns; ++run)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            for (int block = 0; block < blocksPerRun; ++block)
+                subject.process(blockSize);
+
+            runTimes.push_back(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start));
+        }
+
+        std::sort(runTimes.begin(), runTimes.end());
+        const double seconds = runTimes[runTimes.size() / 2];
+        const double numSamples = static_cast<double>(blocksPerRun) * blockSize;
+
+        return { seconds * 1.0e9 / (numSamples * numChannels),
+                 numSamples / sampleRate / juce::jmax(1.0e-12, seconds) };
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    bool quick = false;
+    juce::String filter;
+    juce::File jsonFile;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String argument(argv[i]);
+
+        if (argument == "--quick")
+            quick = true;
+        else if (argument == "--filter" && i + 1 < argc)
+            filter = argv[++i];
+        else if (argument == "--json" && i + 1 < argc)
+            jsonFile = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+        else
+        {
+            std::cout << "Usage: AnalogSaturationBenchmark [--quick] [--filter <text>] [--json <file>]" << std::endl;
+            return argument == "--help" ? 0 : 1;
+        }
+    }
+
+    const std::vector<double> sampleRates = quick ? std::vector<double> { 48000.0 }
+                                                  : std::vector<double> { 44100.0, 48000.0, 96000.0 };
+    const std::vector<int> blockSizes = quick ? std::vector<int> { 512 }
+                                              : std::vector<int> { 32, 128, 512, 2048 };
+    const std::vector<int> channelCounts = quick ? std::vector<int> { 2 }
+                                                 : std::vector<int> { 1, 2, 8, 16 };
+    const double runSeconds = quick ? 0.1 : 0.25;
+    const int numRuns = quick ? 3 : 5;
+
+    juce::Array<juce::var> results;
+
+    std::cout << juce::String("case").paddedRight(' ', 34) << juce::String("rate").paddedLeft(' ', 8)
+              << juce::String("block").paddedLeft(' ', 7) << juce::String("ch").paddedLeft(' ', 4)
+              << juce::String("ns/sample").paddedLeft(' ', 12) << juce::String("realtime").paddedLeft(' ', 12)
+              << std::endl;
+
+    for (const auto& benchmarkCase : makeCases())
+    {
+        if (filter.isNotEmpty() && ! benchmarkCase.name.containsIgnoreCase(filter))
+            continue;
+
+        for (double sampleRate : sampleRates)
+        {
+            for (int blockSize : blockSizes)
+            {
+                for (int numChannels : channelCounts)
+                {
+                    auto subject = benchmarkCase.create();
+                    const auto result = measure(*subject, sampleRate, blockSize, numChannels, runSeconds, numRuns);
+
+                    std::cout << benchmarkCase.name.paddedRight(' ', 34)
+                              << juce::String(juce::roundToInt(sampleRate)).paddedLeft(' ', 8)
+                              << juce::String(blockSize).paddedLeft(' ', 7)
+                              << juce::String(numChannels).paddedLeft(' ', 4)
+                              << juce::String(result.nanosecondsPerSample, 2).paddedLeft(' ', 12)
+                              << (juce::String(result.realtimeFactor, 1) + "x").paddedLeft(' ', 12)
+                              << std::endl;
+
+                    auto* entry = new juce::DynamicObject();
+                    entry->setProperty("case", benchmarkCase.name);
+                    entry->setProperty("sampleRate", sampleRate);
+                    entry->setProperty("blockSize", blockSize);
+                    entry->setProperty("channels", numChannels);
+                    entry->setProperty("nsPerSample", result.nanosecondsPerSample);
+                    entry->setProperty("realtimeFactor", result.realtimeFactor);
+                    results.add(juce::var(entry));
+                }
+            }
+        }
+    }
+
+    if (jsonFile != juce::File())
+    {
+        auto* report = new juce::DynamicObject();
+        report->setProperty("date", juce::Time::getCurrentTime().toISO8601(true));
+        report->setProperty("cpu", juce::SystemStats::getCpuModel());
+        report->setProperty("os", juce::SystemStats::getOperatingSystemName());
+        report->setProperty("numLanes", LaneMath::numLanes);
+        report->setProperty("results", results);
+
+        if (! jsonFile.replaceWithText(juce::JSON::toString(juce::var(report))))
+        {
+            std::cerr << "cannot write " << jsonFile.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,442 @@
+#include <JuceHeader.h>
+#include "../SaturationEngine.h"
+#include <iostream>
+#include <map>
+#include <vector>
+
+/**
+ * Headless batch renderer: runs audio files through SaturationEngine without
+ * a host or an editor.
+ *
+ *     AnalogSaturationRender [options] input1.wav [input2.aiff ...]
+ *
+ *     --preset <file>       JSON object of parameter values, or a saved plugin state
+ *     --automation <file>   JSON object mapping parameter IDs to [seconds, value] breakpoints
+ *     --<parameter> <value> Override one parameter, e.g. --drive 0.8
+ *     --output-dir <dir>    Where to write results (default: next to each input)
+ *     --jobs <n>            Files rendered in parallel (default: one per core)
+ *     --block-size <n>      Streaming block size in samples (default: 65536)
+ *
+ * Each file is streamed through a single block buffer, so memory stays
+ * bounded whatever the file length. The oversampling latency is trimmed from
+ * the start of the output and flushed from the end, so results line up with
+ * their inputs.
+ */
+namespace
+{
+    // Parameter IDs and defaults, as in AnalogSaturationAudioProcessor
+    const std::map<juce::String, float> defaultParameters {
+        { "drive", 0.5f },
+        { "tone", 0.5f },
+        { "mix", 1.0f },
+        { "circuitType", 0.0f },
+        { "modelType", 2.0f },
+        { "oversampling", 0.0f },
+        { "oversamplingMode", 0.0f },
+        { "antialiasing", 0.0f }
+    };
+
+    // Continuous parameters are interpolated between breakpoints; the
+    // others hold their value until the next breakpoint
+    bool isContinuous(const juce::String& id)
+    {
+        return id == "drive" || id == "tone" || id == "mix";
+    }
+
+    struct Breakpoint
+    {
+        double time;
+        float value;
+    };
+
+    struct RenderSettings
+    {
+        std::map<juce::String, float> parameters = defaultParameters;
+        std::map<juce::String, std::vector<Breakpoint>> automation;
+
+        juce::File outputDirectory;
+        int numJobs = juce::SystemStats::getNumCpus();
+        int blockSize = 65536;
+
+        // Automated parameters are updated this often
+        static constexpr int controlBlockSize = 256;
+
+        float getValue(const juce::String& id, double time) const
+        {
+            auto lane = automation.find(id);
+
+            if (lane == automation.end() || lane->second.empty())
+                return parameters.at(id);
+
+            const auto& points = lane->second;
+
+            if (time <= points.front().time)
+                return points.front().value;
+
+            for (size_t i = 1; i < points.size(); ++i)
+            {
+                const auto& next = points[i];
+
+                if (time < next.time)
+                {
+                    const auto& previous = points[i - 1];
+
+                    if (! isContinuous(id))
+                        return previous.value;
+
+                    const double t = (time - previous.time) / (next.time - previous.time);
+                    return previous.value + static_cast<float>(t) * (next.value - previous.value);
+                }
+            }
+
+            return points.back().value;
+        }
+    };
+
+    void applyParameters(SaturationEngine<float>& engine, const RenderSettings& settings, double time)
+    {
+        engine.setDrive(settings.getValue("drive", time));
+        engine.setTone(settings.getValue("tone", time));
+        engine.setMix(settings.getValue("mix", time));
+        engine.setCircuitType(juce::roundToInt(settings.getValue("circuitType", time)));
+        engine.setModelType(juce::roundToInt(settings.getValue("modelType", time)));
+        engine.setOversampling(juce::roundToInt(settings.getValue("oversampling", time)));
+        engine.setOversamplingMode(juce::roundToInt(settings.getValue("oversamplingMode", time)));
+        engine.setAntialiasing(juce::roundToInt(settings.getValue("antialiasing", time)));
+    }
+
+    //==============================================================================
+    juce::Result loadPreset(const juce::File& file, RenderSettings& settings)
+    {
+        // A state saved by the plugin: <AnalogSaturation><PARAM id=".." value=".."/>...
+        if (auto xml = juce::parseXML(file))
+        {
+            for (auto* param : xml->getChildWithTagNameIterator("PARAM"))
+            {
+                const auto id = param->getStringAttribute("id");
+
+                if (settings.parameters.count(id) != 0)
+                    settings.parameters[id] = static_cast<float>(param->getDoubleAttribute("value"));
+            }
+
+            return juce::Result::ok();
+        }
+
+        juce::var json;
+        const auto result = juce::JSON::parse(file.loadFileAsString(), json);
+
+        if (result.failed())
+            return result;
+
+        auto* object = json.getDynamicObject();
+
+        if (object == nullptr)
+            return juce::Result::fail(file.getFileName() + ": expected a JSON object");
+
+        for (const auto& property : object->getProperties())
+        {
+            const auto id = property.name.toString();
+
+            if (settings.parameters.count(id) == 0)
+                return juce::Result::fail(file.getFileName() + ": unknown parameter " + id);
+
+            settings.parameters[id] = static_cast<float>(property.value);
+        }
+
+        return juce::Result::ok();
+    }
+
+    juce::Result loadAutomation(const juce::File& file, RenderSettings& settings)
+    {
+        juce::var json;
+        const auto result = juce::JSON::parse(file.loadFileAsString(), json);
+
+        if (result.failed())
+            return result;
+
+        auto* object = json.getDynamicObject();
+
+        if (object == nullptr)
+            return juce::Result::fail(file.getFileName() + ": expected a JSON object");
+
+        for (const auto& property : object->getProperties())
+        {
+            const auto id = property.name.toString();
+
+            if (settings.parameters.count(id) == 0)
+                return juce::Result::fail(file.getFileName() + ": unknown parameter " + id);
+
+            // Changing the oversampling changes the latency mid-file
+            if (id.startsWith("oversampling"))
+                return juce::Result::fail(file.getFileName() + ": " + id + " cannot be automated");
+
+            std::vector<Breakpoint> points;
+
+            if (auto* array = property.value.getArray())
+            {
+                for (const auto& point : *array)
+                {
+                    if (point.size() != 2)
+                        return juce::Result::fail(file.getFileName() + ": " + id + " breakpoints must be [seconds, value]");
+
+                    points.push_back({ static_cast<double>(point[0]), static_cast<float>(point[1]) });
+                }
+            }
+
+            std::stable_sort(points.begin(), points.end(),
+                             [](const Breakpoint& a, const Breakpoint& b) { return a.time < b.time; });
+            settings.automation[id] = std::move(points);
+        }
+
+        return juce::Result::ok();
+    }
+
+    //==============================================================================
+    struct RenderResult
+    {
+        juce::Result result = juce::Result::ok();
+        double audioSeconds = 0.0;
+        double renderSeconds = 0.0;
+    };
+
+    RenderResult renderFile(const juce::File& input, const juce::File& output, const RenderSettings& settings)
+    {
+        RenderResult render;
+        const double startTime = juce::Time::getMillisecondCounterHiRes();
+
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(input));
+
+        if (reader == nullptr)
+        {
+            render.result = juce::Result::fail("cannot read " + input.getFullPathName());
+            return render;
+        }
+
+        auto* outputFormat = formats.findFormatForFileExtension(output.getFileExtension());
+
+        if (outputFormat == nullptr)
+        {
+            render.result = juce::Result::fail("no writer for " + output.getFileExtension());
+            return render;
+        }
+
+        output.deleteFile();
+        auto stream = std::make_unique<juce::FileOutputStream>(output);
+
+        if (stream->failedToOpen())
+        {
+            render.result = juce::Result::fail("cannot write " + output.getFullPathName());
+            return render;
+        }
+
+        const int numChannels = static_cast<int>(reader->numChannels);
+        const double sampleRate = reader->sampleRate;
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(outputFormat->createWriterFor(stream.get(), sampleRate,
+                                                                                      reader->numChannels,
+                                                                                      static_cast<int>(reader->bitsPerSample),
+                                                                                      reader->metadataValues, 0));
+
+        if (writer == nullptr)
+        {
+            render.result = juce::Result::fail("unsupported output format for " + output.getFileName());
+            return render;
+        }
+
+        // The writer owns the stream now
+        stream.release();
+
+        // Files already run in parallel, so the engine keeps to this thread
+        SaturationEngine<float> engine;
+        engine.setUseWorkerPool(false);
+        applyParameters(engine, settings, 0.0);
+        engine.prepare({ sampleRate, static_cast<juce::uint32>(settings.blockSize),
+                         static_cast<juce::uint32>(numChannels) });
+
+        const juce::int64 latency = engine.getLatencySamples();
+        const juce::int64 totalSamples = reader->lengthInSamples + latency;
+        const int controlBlockSize = settings.automation.empty() ? settings.blockSize
+                                                                 : RenderSettings::controlBlockSize;
+
+        juce::AudioBuffer<float> buffer(numChannels, settings.blockSize);
+        juce::int64 samplesToTrim = latency;
+
+        for (juce::int64 position = 0; position < totalSamples; position += settings.blockSize)
+        {
+            const int numSamples = static_cast<int>(juce::jmin<juce::int64>(settings.blockSize, totalSamples - position));
+
+            // Reads past the end of the file are zero-filled, which flushes the latency
+            reader->read(&buffer, 0, numSamples, position, true, true);
+
+            for (int offset = 0; offset < numSamples; offset += controlBlockSize)
+            {
+                const int subBlockSize = juce::jmin(controlBlockSize, numSamples - offset);
+                applyParameters(engine, settings, static_cast<double>(position + offset) / sampleRate);
+
+                juce::AudioBuffer<float> subBlock(buffer.getArrayOfWritePointers(), numChannels, offset, subBlockSize);
+                engine.processBlock(subBlock);
+            }
+
+            const int trimmed = static_cast<int>(juce::jmin<juce::int64>(samplesToTrim, numSamples));
+            samplesToTrim -= trimmed;
+
+            if (! writer->writeFromAudioSampleBuffer(buffer, trimmed, numSamples - trimmed))
+            {
+                render.result = juce::Result::fail("write failed for " + output.getFullPathName());
+                return render;
+            }
+        }
+
+        writer.reset();
+
+        render.audioSeconds = static_cast<double>(reader->lengthInSamples) / sampleRate;
+        render.renderSeconds = (juce::Time::getMillisecondCounterHiRes() - startTime) * 0.001;
+        return render;
+    }
+
+    juce::File getOutputFile(const juce::File& input, const RenderSettings& settings)
+    {
+        const auto directory = settings.outputDirectory == juce::File() ? input.getParentDirectory()
+                                                                         : settings.outputDirectory;
+        return directory.getChildFile(input.getFileNameWithoutExtension() + "_saturated"
+                                      + input.getFileExtension());
+    }
+
+    void printUsage()
+    {
+        std::cout << "Usage: AnalogSaturationRender [options] input1.wav [input2.aiff ...]\n"
+                     "  --preset <file>        JSON parameter values or a saved plugin state\n"
+                     "  --automation <file>    JSON of {\"parameter\": [[seconds, value], ...]}\n"
+                     "  --<parameter> <value>  drive, tone, mix, circuitType, modelType,\n"
+                     "                         oversampling, oversamplingMode, antialiasing\n"
+                     "  --output-dir <dir>     Output directory (default: next to each input)\n"
+                     "  --jobs <n>             Files rendered in parallel (default: one per core)\n"
+                     "  --block-size <n>       Streaming block size in samples (default: 65536)\n";
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    RenderSettings settings;
+    juce::Array<juce::File> inputs;
+    std::map<juce::String, juce::String> options;
+
+    // Every option takes a value, as "--name value" or "--name=value"
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String argument(argv[i]);
+
+        if (argument == "--help" || argument == "-h")
+        {
+            printUsage();
+            return 0;
+        }
+
+        if (argument.startsWith("--"))
+        {
+            const auto name = argument.substring(2).upToFirstOccurrenceOf("=", false, false);
+
+            if (argument.containsChar('='))
+                options[name] = argument.fromFirstOccurrenceOf("=", false, false);
+            else if (i + 1 < argc)
+                options[name] = juce::String(argv[++i]);
+            else
+                options[name] = {};
+        }
+        else
+        {
+            inputs.add(juce::File::getCurrentWorkingDirectory().getChildFile(argument));
+        }
+    }
+
+    if (inputs.isEmpty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    auto fail = [](const juce::String& message)
+    {
+        std::cerr << message << std::endl;
+        return 1;
+    };
+
+    auto cwd = juce::File::getCurrentWorkingDirectory();
+
+    // The preset first, so that single overrides win over it
+    if (options.count("preset") != 0)
+    {
+        const auto result = loadPreset(cwd.getChildFile(options["preset"]), settings);
+
+        if (result.failed())
+            return fail(result.getErrorMessage());
+    }
+
+    if (options.count("automation") != 0)
+    {
+        const auto result = loadAutomation(cwd.getChildFile(options["automation"]), settings);
+
+        if (result.failed())
+            return fail(result.getErrorMessage());
+    }
+
+    for (const auto& [name, value] : options)
+    {
+        if (name == "preset" || name == "automation")
+            continue;
+
+        if (name == "output-dir")
+            settings.outputDirectory = cwd.getChildFile(value);
+        else if (name == "jobs")
+            settings.numJobs = juce::jmax(1, value.getIntValue());
+        else if (name == "block-size")
+            settings.blockSize = juce::jmax(RenderSettings::controlBlockSize, value.getIntValue());
+        else if (settings.parameters.count(name) != 0)
+            settings.parameters[name] = value.getFloatValue();
+        else
+            return fail("unknown option --" + name);
+    }
+
+    if (settings.outputDirectory != juce::File() && settings.outputDirectory.createDirectory().failed())
+        return fail("cannot create " + settings.outputDirectory.getFullPathName());
+
+    juce::CriticalSection printLock;
+    std::atomic<int> numFailed { 0 };
+
+    {
+        juce::ThreadPool pool(juce::jmin(settings.numJobs, inputs.size()));
+
+        for (const auto& input : inputs)
+        {
+            pool.addJob([&, input]
+            {
+                const auto output = getOutputFile(input, settings);
+                const auto render = renderFile(input, output, settings);
+
+                const juce::ScopedLock lock(printLock);
+
+                if (render.result.failed())
+                {
+                    ++numFailed;
+                    std::cerr << input.getFileName() << ": " << render.result.getErrorMessage() << std::endl;
+                    return;
+                }
+
+                std::cout << input.getFileName() << " -> " << output.getFullPathName() << ": "
+                          << juce::String(render.audioSeconds, 2) << " s in "
+                          << juce::String(render.renderSeconds, 2) << " s ("
+                          << juce::String(render.audioSeconds / juce::jmax(1.0e-9, render.renderSeconds), 1)
+                          << "x realtime)" << std::endl;
+            });
+        }
+
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep(20);
+    }
+
+    return numFailed > 0 ? 1 : 0;
+}
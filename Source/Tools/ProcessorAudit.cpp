@@ -0,0 +1,219 @@
+#include <JuceHeader.h>
+#include "../PluginProcessor.h"
+#include "RealtimeAudit.h"
+#include <iostream>
+#include <iterator>
+#include <type_traits>
+
+/**
+ * Real-time-safety audit for AnalogSaturationAudioProcessor::processBlock.
+ *
+ *     AnalogSaturationRealtimeAudit [--blocks <n>]
+ *
+ * Drives the processor through every supported precision and a range of
+ * channel layouts. Between blocks it changes parameters the way host
+ * automation would, and it varies the block size and inserts stretches of
+ * silence so that kernel crossfades, oversampling switches, silence
+ * skipping and the worker pool all run. Any allocation, lock or blocking
+ * system call made during processBlock, on the audio thread or a worker, is
+ * reported; the solution-table builder thread is exempt. The worker pool's
+ * futex wake-ups and idle waits are allowed and counted per scenario. The
+ * exit code is non-zero if anything was found.
+ *
+ * Preparing, releasing and changing layouts happen outside the audited
+ * region, as they do in a host.
+ */
+namespace
+{
+    struct Layout
+    {
+        const char* name;
+        juce::AudioChannelSet channels;
+    };
+
+    // Parameter changes applied in turn, one every few blocks
+    struct Change
+    {
+        const char* id;
+        float value;
+    };
+
+    const Change parameterChanges[] = {
+        { "drive", 0.9f }, { "circuitType", 1.0f }, { "modelType", 0.0f }, { "tone", 0.1f },
+        { "circuitType", 2.0f }, { "oversampling", 1.0f }, { "modelType", 1.0f }, { "antialiasing", 1.0f },
+        { "circuitType", 3.0f }, { "oversampling", 3.0f }, { "oversamplingMode", 1.0f }, { "mix", 0.5f },
+        { "modelType", 2.0f }, { "antialiasing", 2.0f }, { "circuitType", 0.0f }, { "oversampling", 2.0f },
+        { "drive", 0.2f }, { "oversamplingMode", 0.0f }, { "tone", 0.9f }, { "oversampling", 0.0f },
+        { "antialiasing", 0.0f }, { "mix", 1.0f }
+    };
+
+    void setParameter(AnalogSaturationAudioProcessor& processor, const char* id, float value)
+    {
+        if (auto* parameter = processor.getValueTreeState().getParameter(id))
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    void resetParameters(AnalogSaturationAudioProcessor& processor)
+    {
+        for (auto* parameter : processor.getParameters())
+            parameter->setValueNotifyingHost(parameter->getDefaultValue());
+    }
+
+    template <typename SampleType>
+    int auditLayout(AnalogSaturationAudioProcessor& processor, const Layout& layout, int numBlocks)
+    {
+        constexpr double sampleRate = 48000.0;
+        constexpr int maximumBlockSize = 512;
+
+        const bool doublePrecision = std::is_same_v<SampleType, double>;
+        const juce::String scenario = juce::String(layout.name) + (doublePrecision ? ", 64-bit" : ", 32-bit");
+
+        juce::AudioProcessor::BusesLayout buses;
+        buses.inputBuses.add(layout.channels);
+        buses.outputBuses.add(layout.channels);
+
+        processor.releaseResources();
+
+        if (! processor.setBusesLayout(buses))
+        {
+            std::cout << scenario << ": layout rejected" << std::endl;
+            return 1;
+        }
+
+        resetParameters(processor);
+        processor.setProcessingPrecision(doublePrecision ? juce::AudioProcessor::doublePrecision
+                                                         : juce::AudioProcessor::singlePrecision);
+        processor.setRateAndBufferSizeDetails(sampleRate, maximumBlockSize);
+        processor.prepareToPlay(sampleRate, maximumBlockSize);
+
+        const int numChannels = layout.channels.size();
+        juce::AudioBuffer<SampleType> buffer(numChannels, maximumBlockSize);
+        juce::MidiBuffer midi;
+        juce::Random random(1);
+
+        int numFailures = 0;
+        int sampleIndex = 0;
+
+        // Allowed worker pool hand-offs, reported for reference
+        int numFutexWakes = 0;
+        int numFutexIdleWaits = 0;
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            if (block % 8 == 7)
+            {
+                const auto& change = parameterChanges[static_cast<size_t>(block / 8) % std::size(parameterChanges)];
+                setParameter(processor, change.id, change.value);
+            }
+
+            // Odd block sizes, as some hosts deliver, and a silent stretch
+            // that lets the lane groups go to sleep and wake again
+            const int numSamples = block % 5 == 4 ? 37 : maximumBlockSize - (block % 3) * 64;
+            const bool silent = (block / 64) % 3 == 2;
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto* samples = buffer.getWritePointer(channel);
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    const double phase = juce::MathConstants<double>::twoPi * 220.0 * (sampleIndex + i) / sampleRate;
+                    samples[i] = silent ? SampleType(0)
+                                        : static_cast<SampleType>(0.5 * std::sin(phase + channel)
+                                                                  + 0.01 * (random.nextDouble() - 0.5));
+                }
+            }
+
+            sampleIndex += numSamples;
+
+            // A view of the first numSamples, made outside the audited region
+            juce::AudioBuffer<SampleType> hostBuffer(buffer.getArrayOfWritePointers(), numChannels, 0, numSamples);
+
+            {
+                RealtimeAudit::ScopedAudioCallback audioCallback;
+                processor.processBlock(hostBuffer, midi);
+            }
+
+            const auto report = RealtimeAudit::takeReport();
+            numFutexWakes += report.futexWakes;
+            numFutexIdleWaits += report.futexIdleWaits;
+
+            if (! report.isClean())
+            {
+                if (numFailures++ < 5)
+                {
+                    std::cout << scenario << ", block " << block << ":";
+
+                    for (int kind = 0; kind < RealtimeAudit::numKinds; ++kind)
+                        if (report.counts[static_cast<size_t>(kind)] > 0)
+                            std::cout << " " << report.counts[static_cast<size_t>(kind)] << " "
+                                      << RealtimeAudit::getKindName(static_cast<RealtimeAudit::Kind>(kind));
+
+                    std::cout << " (first: " << report.firstCall << ")" << std::endl;
+                }
+            }
+        }
+
+        processor.releaseResources();
+
+        std::cout << scenario << ": " << (numFailures == 0 ? "clean" : juce::String(numFailures) + " blocks failed")
+                  << " (" << numFutexWakes << " futex wake-ups, " << numFutexIdleWaits << " idle worker waits)"
+                  << std::endl;
+
+        return numFailures;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    int numBlocks = 1000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String argument(argv[i]);
+
+        if (argument == "--blocks" && i + 1 < argc)
+            numBlocks = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+        else
+        {
+            std::cout << "Usage: AnalogSaturationRealtimeAudit [--blocks <n>]" << std::endl;
+            return argument == "--help" ? 0 : 1;
+        }
+    }
+
+    if (! RealtimeAudit::isSupported())
+    {
+        std::cout << "The real-time audit hooks need Linux with glibc" << std::endl;
+        return 1;
+    }
+
+    // The state-space solution tables are built on this low-priority thread
+    // while the callback falls back to the Newton solver; it is meant to
+    // allocate and lock
+    RealtimeAudit::ignoreThread("Solution tables");
+
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    AnalogSaturationAudioProcessor processor;
+
+    // Record analysis frames as if the editor were open
+    processor.getAnalysisFifo().setActive(true);
+
+    const Layout layouts[] = {
+        { "mono", juce::AudioChannelSet::mono() },
+        { "stereo", juce::AudioChannelSet::stereo() },
+        { "5.1", juce::AudioChannelSet::create5point1() },
+        { "7.1.4", juce::AudioChannelSet::create7point1point4() },
+        { "3rd-order ambisonic", juce::AudioChannelSet::ambisonic(3) }
+    };
+
+    int numFailures = 0;
+
+    for (const auto& layout : layouts)
+    {
+        numFailures += auditLayout<float>(processor, layout, numBlocks);
+        numFailures += auditLayout<double>(processor, layout, numBlocks);
+    }
+
+    return numFailures == 0 ? 0 : 1;
+}
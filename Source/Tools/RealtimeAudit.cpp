@@ -0,0 +1,419 @@
+#include "RealtimeAudit.h"
+#include <atomic>
+#include <cstring>
+
+#if defined (__linux__) && defined (__GLIBC__)
+ #define REALTIME_AUDIT_HOOKS 1
+#else
+ #define REALTIME_AUDIT_HOOKS 0
+#endif
+
+#if REALTIME_AUDIT_HOOKS
+ #include <cerrno>
+ #include <dlfcn.h>
+ #include <fcntl.h>
+ #include <linux/futex.h>
+ #include <pthread.h>
+ #include <sched.h>
+ #include <semaphore.h>
+ #include <stdarg.h>
+ #include <sys/mman.h>
+ #include <sys/syscall.h>
+ #include <time.h>
+ #include <unistd.h>
+#endif
+
+namespace RealtimeAudit
+{
+    namespace
+    {
+        // Number of audio callbacks in progress, on any thread
+        std::atomic<int> activeCallbacks { 0 };
+
+        std::array<std::atomic<int>, numKinds> counts {};
+        std::atomic<const char*> firstCall { nullptr };
+        std::atomic<int> futexWakes { 0 };
+        std::atomic<int> futexIdleWaits { 0 };
+
+        // Audio callbacks in progress on this thread
+        thread_local int callbackDepth = 0;
+
+        // Set while this thread is inside a hook, so that work done by the
+        // audit itself is never reported
+        thread_local bool insideHook = false;
+
+        // Thread names passed to ignoreThread()
+        constexpr int maxIgnoredThreads = 8;
+        constexpr size_t threadNameLength = 15;
+        std::array<const char*, maxIgnoredThreads> ignoredThreads {};
+        std::atomic<int> numIgnoredThreads { 0 };
+
+        // Whether this thread's calls are recorded, looked up on first use
+        enum class ThreadState { unknown, audited, ignored };
+        thread_local ThreadState threadState = ThreadState::unknown;
+
+        bool isAuditedThread()
+        {
+           #if REALTIME_AUDIT_HOOKS
+            if (threadState == ThreadState::unknown)
+            {
+                // For the calling thread this is a prctl, which no hook sees
+                char name[threadNameLength + 1] {};
+                pthread_getname_np(pthread_self(), name, sizeof(name));
+
+                threadState = ThreadState::audited;
+
+                for (int i = 0; i < numIgnoredThreads.load(); ++i)
+                    if (std::strncmp(name, ignoredThreads[static_cast<size_t>(i)], threadNameLength) == 0)
+                        threadState = ThreadState::ignored;
+            }
+           #endif
+
+            return threadState != ThreadState::ignored;
+        }
+
+        // True if a call made now on this thread is audited; the hook is
+        // then entered and the caller leaves it by clearing insideHook
+        bool enterHook()
+        {
+            if (activeCallbacks.load(std::memory_order_relaxed) == 0 || insideHook)
+                return false;
+
+            insideHook = true;
+
+            if (isAuditedThread())
+                return true;
+
+            insideHook = false;
+            return false;
+        }
+    }
+
+    // Called by every hook before forwarding
+    void record(Kind kind, const char* call)
+    {
+        if (! enterHook())
+            return;
+
+        counts[static_cast<size_t>(kind)].fetch_add(1, std::memory_order_relaxed);
+
+        const char* expected = nullptr;
+        firstCall.compare_exchange_strong(expected, call);
+
+        insideHook = false;
+    }
+
+   #if REALTIME_AUDIT_HOOKS
+    // Called by the syscall() hook for SYS_futex
+    void recordFutex(int operation)
+    {
+        const int command = operation & FUTEX_CMD_MASK;
+        const bool isWait = command == FUTEX_WAIT || command == FUTEX_WAIT_BITSET;
+
+        if (command != FUTEX_WAKE && ! (isWait && callbackDepth == 0))
+        {
+            record(isWait ? Kind::Lock : Kind::SystemCall, isWait ? "futex wait" : "futex");
+            return;
+        }
+
+        if (! enterHook())
+            return;
+
+        (isWait ? futexIdleWaits : futexWakes).fetch_add(1, std::memory_order_relaxed);
+
+        insideHook = false;
+    }
+   #endif
+
+    const char* getKindName(Kind kind)
+    {
+        switch (kind)
+        {
+            case Kind::Allocation:      return "allocation";
+            case Kind::Deallocation:    return "deallocation";
+            case Kind::Lock:            return "lock";
+            case Kind::SystemCall:      return "system call";
+        }
+
+        return "";
+    }
+
+    bool isSupported()
+    {
+        return REALTIME_AUDIT_HOOKS != 0;
+    }
+
+    Report takeReport()
+    {
+        Report report;
+
+        for (size_t kind = 0; kind < counts.size(); ++kind)
+            report.counts[kind] = counts[kind].exchange(0);
+
+        report.firstCall = firstCall.exchange(nullptr);
+        report.futexWakes = futexWakes.exchange(0);
+        report.futexIdleWaits = futexIdleWaits.exchange(0);
+        return report;
+    }
+
+    void ignoreThread(const char* name)
+    {
+        const int index = numIgnoredThreads.load();
+
+        if (index < maxIgnoredThreads)
+        {
+            ignoredThreads[static_cast<size_t>(index)] = name;
+            numIgnoredThreads.store(index + 1);
+        }
+    }
+
+    ScopedAudioCallback::ScopedAudioCallback()
+    {
+        ++callbackDepth;
+        activeCallbacks.fetch_add(1);
+    }
+
+    ScopedAudioCallback::~ScopedAudioCallback()
+    {
+        activeCallbacks.fetch_sub(1);
+        --callbackDepth;
+    }
+}
+
+#if REALTIME_AUDIT_HOOKS
+
+using RealtimeAudit::Kind;
+using RealtimeAudit::record;
+using RealtimeAudit::recordFutex;
+
+namespace
+{
+    // The next definition of a symbol, normally the one in libc. Resolved on
+    // first use; dlsym only allocates through glibc's own allocator.
+    template <typename Function>
+    Function next(Function& cache, const char* name)
+    {
+        if (cache == nullptr)
+            cache = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+
+        return cache;
+    }
+}
+
+// glibc's allocator entry points, which the replacements below forward to
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void* __libc_memalign(size_t, size_t);
+extern "C" void __libc_free(void*);
+
+extern "C"
+{
+    //==============================================================================
+    // Allocation. operator new and delete reach these through libstdc++.
+    void* malloc(size_t size)
+    {
+        record(Kind::Allocation, "malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        record(Kind::Allocation, "calloc");
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* pointer, size_t size)
+    {
+        record(Kind::Allocation, "realloc");
+        return __libc_realloc(pointer, size);
+    }
+
+    void* memalign(size_t alignment, size_t size)
+    {
+        record(Kind::Allocation, "memalign");
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        record(Kind::Allocation, "aligned_alloc");
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** result, size_t alignment, size_t size)
+    {
+        record(Kind::Allocation, "posix_memalign");
+
+        void* pointer = __libc_memalign(alignment, size);
+
+        if (pointer == nullptr)
+            return ENOMEM;
+
+        *result = pointer;
+        return 0;
+    }
+
+    void free(void* pointer)
+    {
+        if (pointer != nullptr)
+            record(Kind::Deallocation, "free");
+
+        __libc_free(pointer);
+    }
+
+    //==============================================================================
+    // Blocking synchronisation. Try-locks never block and are allowed.
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        static int (*function)(pthread_mutex_t*) = nullptr;
+        record(Kind::Lock, "pthread_mutex_lock");
+        return next(function, "pthread_mutex_lock")(mutex);
+    }
+
+    int pthread_rwlock_rdlock(pthread_rwlock_t* lock)
+    {
+        static int (*function)(pthread_rwlock_t*) = nullptr;
+        record(Kind::Lock, "pthread_rwlock_rdlock");
+        return next(function, "pthread_rwlock_rdlock")(lock);
+    }
+
+    int pthread_rwlock_wrlock(pthread_rwlock_t* lock)
+    {
+        static int (*function)(pthread_rwlock_t*) = nullptr;
+        record(Kind::Lock, "pthread_rwlock_wrlock");
+        return next(function, "pthread_rwlock_wrlock")(lock);
+    }
+
+    int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+    {
+        static int (*function)(pthread_cond_t*, pthread_mutex_t*) = nullptr;
+        record(Kind::Lock, "pthread_cond_wait");
+        return next(function, "pthread_cond_wait")(condition, mutex);
+    }
+
+    int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* time)
+    {
+        static int (*function)(pthread_cond_t*, pthread_mutex_t*, const struct timespec*) = nullptr;
+        record(Kind::Lock, "pthread_cond_timedwait");
+        return next(function, "pthread_cond_timedwait")(condition, mutex, time);
+    }
+
+    int pthread_join(pthread_t thread, void** result)
+    {
+        static int (*function)(pthread_t, void**) = nullptr;
+        record(Kind::Lock, "pthread_join");
+        return next(function, "pthread_join")(thread, result);
+    }
+
+    int sem_wait(sem_t* semaphore)
+    {
+        static int (*function)(sem_t*) = nullptr;
+        record(Kind::Lock, "sem_wait");
+        return next(function, "sem_wait")(semaphore);
+    }
+
+    //==============================================================================
+    // System calls that block or take unbounded time
+    ssize_t read(int file, void* buffer, size_t size)
+    {
+        static ssize_t (*function)(int, void*, size_t) = nullptr;
+        record(Kind::SystemCall, "read");
+        return next(function, "read")(file, buffer, size);
+    }
+
+    ssize_t write(int file, const void* buffer, size_t size)
+    {
+        static ssize_t (*function)(int, const void*, size_t) = nullptr;
+        record(Kind::SystemCall, "write");
+        return next(function, "write")(file, buffer, size);
+    }
+
+    int open(const char* path, int flags, ...)
+    {
+        static int (*function)(const char*, int, ...) = nullptr;
+        record(Kind::SystemCall, "open");
+
+        va_list arguments;
+        va_start(arguments, flags);
+        const auto mode = static_cast<mode_t>(va_arg(arguments, int));
+        va_end(arguments);
+
+        return next(function, "open")(path, flags, mode);
+    }
+
+    int close(int file)
+    {
+        static int (*function)(int) = nullptr;
+        record(Kind::SystemCall, "close");
+        return next(function, "close")(file);
+    }
+
+    int nanosleep(const struct timespec* duration, struct timespec* remaining)
+    {
+        static int (*function)(const struct timespec*, struct timespec*) = nullptr;
+        record(Kind::SystemCall, "nanosleep");
+        return next(function, "nanosleep")(duration, remaining);
+    }
+
+    int clock_nanosleep(clockid_t clock, int flags, const struct timespec* duration, struct timespec* remaining)
+    {
+        static int (*function)(clockid_t, int, const struct timespec*, struct timespec*) = nullptr;
+        record(Kind::SystemCall, "clock_nanosleep");
+        return next(function, "clock_nanosleep")(clock, flags, duration, remaining);
+    }
+
+    int usleep(useconds_t duration)
+    {
+        static int (*function)(useconds_t) = nullptr;
+        record(Kind::SystemCall, "usleep");
+        return next(function, "usleep")(duration);
+    }
+
+    int sched_yield()
+    {
+        static int (*function)() = nullptr;
+        record(Kind::SystemCall, "sched_yield");
+        return next(function, "sched_yield")();
+    }
+
+    void* mmap(void* address, size_t length, int protection, int flags, int file, off_t offset)
+    {
+        static void* (*function)(void*, size_t, int, int, int, off_t) = nullptr;
+        record(Kind::SystemCall, "mmap");
+        return next(function, "mmap")(address, length, protection, flags, file, offset);
+    }
+
+    int munmap(void* address, size_t length)
+    {
+        static int (*function)(void*, size_t) = nullptr;
+        record(Kind::SystemCall, "munmap");
+        return next(function, "munmap")(address, length);
+    }
+
+    //==============================================================================
+    // Raw system calls. The kernel takes at most six arguments in registers,
+    // so all six are forwarded whatever the call uses.
+    long syscall(long number, ...)
+    {
+        static long (*function)(long, ...) = nullptr;
+
+        va_list arguments;
+        va_start(arguments, number);
+        long a[6];
+
+        for (auto& argument : a)
+            argument = va_arg(arguments, long);
+
+        va_end(arguments);
+
+        if (number == SYS_futex)
+            recordFutex(static_cast<int>(a[1]));
+        else
+            record(Kind::SystemCall, "syscall");
+
+        return next(function, "syscall")(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+    }
+}
+
+#endif
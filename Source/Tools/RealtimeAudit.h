@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+/**
+ * Detection of real-time-unsafe calls made while an audio callback runs.
+ *
+ * Linking RealtimeAudit.cpp into an executable replaces the C allocator and
+ * interposes the blocking pthread calls, common system calls and raw
+ * syscall(). While any ScopedAudioCallback is alive, every such call, on any
+ * thread not excluded with ignoreThread(), is counted as a violation.
+ * Outside a callback the hooks only forward.
+ *
+ * Two raw futex operations are allowed, and counted in the report instead:
+ * FUTEX_WAKE, which never blocks the caller, and a wait on a thread other
+ * than the callback's, which is a helper parking once it runs out of work.
+ * A futex wait on the callback's own thread is a lock.
+ *
+ * The hooks need symbol interposition and are only active on Linux with
+ * glibc; elsewhere isSupported() returns false and nothing is recorded.
+ * This is a development tool: never link it into a plugin.
+ */
+namespace RealtimeAudit
+{
+    enum class Kind
+    {
+        Allocation,     // malloc, calloc, realloc, aligned allocation, operator new
+        Deallocation,   // free, operator delete
+        Lock,           // mutex, rwlock, condition variable and semaphore waits
+        SystemCall      // file and socket I/O, sleeping, yielding, memory mapping, raw syscall()
+    };
+
+    static constexpr int numKinds = 4;
+
+    const char* getKindName(Kind kind);
+
+    struct Report
+    {
+        std::array<int, numKinds> counts {};
+        const char* firstCall = nullptr;   // Name of the first offending call
+
+        // Allowed raw futex operations, not violations
+        int futexWakes = 0;
+        int futexIdleWaits = 0;
+
+        bool isClean() const
+        {
+            for (int count : counts)
+                if (count != 0)
+                    return false;
+
+            return true;
+        }
+    };
+
+    // True if the hooks are compiled in for this platform
+    bool isSupported();
+
+    // Return the violations recorded since the last call and clear them
+    Report takeReport();
+
+    // Never record calls made by threads with this name: background threads
+    // that only serve the callback, such as a resource builder, and may
+    // allocate or lock while it runs. Names are compared as the system
+    // stores them, truncated to 15 characters. Call before auditing.
+    void ignoreThread(const char* name);
+
+    // Marks the lifetime of one audio callback, on the thread running it
+    class ScopedAudioCallback
+    {
+    public:
+        ScopedAudioCallback();
+        ~ScopedAudioCallback();
+
+        ScopedAudioCallback(const ScopedAudioCallback&) = delete;
+        ScopedAudioCallback& operator=(const ScopedAudioCallback&) = delete;
+    };
+}
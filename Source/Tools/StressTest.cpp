@@ -0,0 +1,258 @@
+#include <JuceHeader.h>
+#include "../SaturationEngine.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * Multi-threaded stress test for SaturationEngine.
+ *
+ *     AnalogSaturationStressTest [--threads <n>] [--seconds <s>] [--oversampling <0-3>]
+ *
+ * Each engine instance renders its own test signal, first alone on the main
+ * thread and then with N instances running at once on N threads, for N = 1,
+ * 2, 4, ... up to --threads (default: one per core). The concurrent output
+ * must be bit-identical to the single-threaded one: any state shared between
+ * instances, or any race on it, shows up as a difference. The shared
+ * solution tables are built in prepare(), so the output does not depend on
+ * when the builder thread gets to them.
+ *
+ * Scaling efficiency is the single-threaded time for the N instances over N
+ * times the wall time of the concurrent run; 100 % means N threads do N
+ * times the work. The engines keep to their own thread, as the worker pool
+ * would otherwise compete for the same cores.
+ *
+ * Exits with 1 if any output differs.
+ */
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+    constexpr int numChannels = 2;
+
+    // Every instance hears a different signal, so crosstalk cannot cancel out
+    double testSignal(int instance, int channel, int index)
+    {
+        const double frequency = 55.0 * (1.0 + 0.25 * instance);
+        const double phase = juce::MathConstants<double>::twoPi * frequency * index / sampleRate;
+        return 0.5 * std::sin(phase + 0.5 * channel);
+    }
+
+    struct Render
+    {
+        juce::AudioBuffer<float> output;
+        double seconds = 0.0;
+    };
+
+    // Renders numBlocks blocks through a fresh engine; the timed part is the
+    // block loop only
+    class Instance
+    {
+    public:
+        Instance(int instanceIndex, int oversamplingIndex, int blocksToRender)
+            : index(instanceIndex), oversampling(oversamplingIndex), numBlocks(blocksToRender)
+        {
+        }
+
+        void prepare()
+        {
+            engine = std::make_unique<SaturationEngine<float>>();
+            engine->setUseWorkerPool(false);
+            engine->setDrive(0.7f);
+            engine->setOversampling(oversampling);
+            engine->prepare({ sampleRate, static_cast<juce::uint32>(blockSize), static_cast<juce::uint32>(numChannels) });
+
+            buffer.setSize(numChannels, blockSize);
+            render.output.setSize(numChannels, numBlocks * blockSize);
+        }
+
+        void process()
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            for (int block = 0; block < numBlocks; ++block)
+            {
+                const int offset = block * blockSize;
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                    for (int i = 0; i < blockSize; ++i)
+                        buffer.setSample(channel, i, static_cast<float>(testSignal(index, channel, offset + i)));
+
+                engine->processBlock(buffer);
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                    render.output.copyFrom(channel, offset, buffer, channel, 0, blockSize);
+            }
+
+            endTicks = juce::Time::getHighResolutionTicks();
+            render.seconds = juce::Time::highResolutionTicksToSeconds(endTicks - start);
+        }
+
+        const Render& getRender() const { return render; }
+        juce::int64 getEndTicks() const { return endTicks; }
+
+    private:
+        int index;
+        int oversampling;
+        int numBlocks;
+        std::unique_ptr<SaturationEngine<float>> engine;
+        juce::AudioBuffer<float> buffer;
+        Render render;
+        juce::int64 endTicks = 0;
+    };
+
+    bool isBitIdentical(const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+    {
+        if (a.getNumChannels() != b.getNumChannels() || a.getNumSamples() != b.getNumSamples())
+            return false;
+
+        for (int channel = 0; channel < a.getNumChannels(); ++channel)
+        {
+            const size_t numBytes = sizeof(float) * static_cast<size_t>(a.getNumSamples());
+
+            if (std::memcmp(a.getReadPointer(channel), b.getReadPointer(channel), numBytes) != 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    // Runs the instances at once, one thread each, released together;
+    // returns the wall time from the release to the last one finishing
+    double runConcurrently(std::vector<std::unique_ptr<Instance>>& instances)
+    {
+        const int numThreads = static_cast<int>(instances.size());
+        std::atomic<int> numReady { 0 };
+        std::atomic<bool> go { false };
+        juce::int64 startTicks = 0;
+
+        {
+            juce::ThreadPool pool(numThreads);
+
+            for (auto& instance : instances)
+            {
+                pool.addJob([&, current = instance.get()]
+                {
+                    current->prepare();
+                    ++numReady;
+
+                    while (! go.load())
+                        std::this_thread::yield();
+
+                    current->process();
+                });
+            }
+
+            while (numReady.load() < numThreads)
+                std::this_thread::yield();
+
+            startTicks = juce::Time::getHighResolutionTicks();
+            go = true;
+
+            while (pool.getNumJobs() > 0)
+                juce::Thread::sleep(1);
+        }
+
+        juce::int64 endTicks = startTicks;
+
+        for (const auto& instance : instances)
+            endTicks = std::max(endTicks, instance->getEndTicks());
+
+        return juce::Time::highResolutionTicksToSeconds(endTicks - startTicks);
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    int maxThreads = juce::SystemStats::getNumCpus();
+    double seconds = 2.0;
+    int oversampling = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String argument(argv[i]);
+
+        if (argument == "--threads" && i + 1 < argc)
+            maxThreads = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+        else if (argument == "--seconds" && i + 1 < argc)
+            seconds = juce::jmax(0.01, juce::String(argv[++i]).getDoubleValue());
+        else if (argument == "--oversampling" && i + 1 < argc)
+            oversampling = juce::jlimit(0, 3, juce::String(argv[++i]).getIntValue());
+        else
+        {
+            std::cout << "Usage: AnalogSaturationStressTest [--threads <n>] [--seconds <s>] [--oversampling <0-3>]" << std::endl;
+            return argument == "--help" ? 0 : 1;
+        }
+    }
+
+    const int numBlocks = juce::jmax(1, juce::roundToInt(seconds * sampleRate / blockSize));
+
+    // Reference renders, one instance at a time on this thread
+    std::vector<Render> references;
+
+    for (int index = 0; index < maxThreads; ++index)
+    {
+        Instance instance(index, oversampling, numBlocks);
+        instance.prepare();
+        instance.process();
+        references.push_back(instance.getRender());
+    }
+
+    std::cout << juce::String("threads").paddedLeft(' ', 8) << juce::String("single").paddedLeft(' ', 10)
+              << juce::String("parallel").paddedLeft(' ', 10) << juce::String("speedup").paddedLeft(' ', 9)
+              << juce::String("efficiency").paddedLeft(' ', 12) << juce::String("output").paddedLeft(' ', 10)
+              << std::endl;
+
+    int numFailed = 0;
+
+    for (int numThreads = 1;; numThreads = juce::jmin(numThreads * 2, maxThreads))
+    {
+        std::vector<std::unique_ptr<Instance>> instances;
+
+        for (int index = 0; index < numThreads; ++index)
+            instances.push_back(std::make_unique<Instance>(index, oversampling, numBlocks));
+
+        const double parallelSeconds = runConcurrently(instances);
+
+        double singleSeconds = 0.0;
+        int numDiffering = 0;
+
+        for (int index = 0; index < numThreads; ++index)
+        {
+            const auto& reference = references[static_cast<size_t>(index)];
+            singleSeconds += reference.seconds;
+
+            if (! isBitIdentical(instances[static_cast<size_t>(index)]->getRender().output, reference.output))
+                ++numDiffering;
+        }
+
+        numFailed += numDiffering;
+
+        const double speedup = singleSeconds / juce::jmax(1.0e-12, parallelSeconds);
+
+        std::cout << juce::String(numThreads).paddedLeft(' ', 8)
+                  << (juce::String(singleSeconds, 3) + "s").paddedLeft(' ', 10)
+                  << (juce::String(parallelSeconds, 3) + "s").paddedLeft(' ', 10)
+                  << (juce::String(speedup, 2) + "x").paddedLeft(' ', 9)
+                  << (juce::String(100.0 * speedup / numThreads, 1) + "%").paddedLeft(' ', 12)
+                  << (numDiffering == 0 ? juce::String("same")
+                                        : juce::String(numDiffering) + " differ").paddedLeft(' ', 10)
+                  << std::endl;
+
+        if (numThreads == maxThreads)
+            break;
+    }
+
+    if (numFailed > 0)
+    {
+        std::cerr << numFailed << " concurrent renders differ from their single-threaded reference" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
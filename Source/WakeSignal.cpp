@@ -0,0 +1,63 @@
+#include "WakeSignal.h"
+
+#if JUCE_LINUX
+ #include <linux/futex.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#elif JUCE_WINDOWS
+ #include <windows.h>
+ #if JUCE_MSVC
+  #pragma comment (lib, "Synchronization.lib")
+ #endif
+#elif JUCE_MAC
+ #include <dispatch/dispatch.h>
+#endif
+
+WakeSignal::WakeSignal()
+{
+   #if JUCE_MAC
+    semaphore = dispatch_semaphore_create(0);
+   #endif
+}
+
+WakeSignal::~WakeSignal()
+{
+   #if JUCE_MAC
+    dispatch_release(static_cast<dispatch_semaphore_t>(semaphore));
+   #endif
+}
+
+void WakeSignal::notify()
+{
+    // Already signalled: the waiting thread has not gone to sleep on it yet
+    if (signalled.exchange(1, std::memory_order_release) != 0)
+        return;
+
+   #if JUCE_LINUX
+    syscall(SYS_futex, &signalled, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+   #elif JUCE_WINDOWS
+    WakeByAddressSingle(&signalled);
+   #elif JUCE_MAC
+    dispatch_semaphore_signal(static_cast<dispatch_semaphore_t>(semaphore));
+   #else
+    event.signal();
+   #endif
+}
+
+void WakeSignal::wait()
+{
+    // Sleep only while the flag is still clear; spurious wake-ups just loop
+    while (signalled.exchange(0, std::memory_order_acquire) == 0)
+    {
+       #if JUCE_LINUX
+        syscall(SYS_futex, &signalled, FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+       #elif JUCE_WINDOWS
+        int clear = 0;
+        WaitOnAddress(&signalled, &clear, sizeof(clear), INFINITE);
+       #elif JUCE_MAC
+        dispatch_semaphore_wait(static_cast<dispatch_semaphore_t>(semaphore), DISPATCH_TIME_FOREVER);
+       #else
+        event.wait(-1);
+       #endif
+    }
+}
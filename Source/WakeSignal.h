@@ -0,0 +1,32 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+/**
+ * Auto-reset wake-up flag for handing work from the audio thread to a
+ * sleeping thread.
+ *
+ * notify() is an atomic exchange, plus a kernel wake only when the flag was
+ * clear (a futex on Linux, an address wait on Windows, a dispatch semaphore
+ * on macOS); it never waits on a lock, so the audio thread may call it.
+ * wait() sleeps until the flag is set and clears it again.
+ */
+class WakeSignal
+{
+public:
+    WakeSignal();
+    ~WakeSignal();
+
+    void notify();
+    void wait();
+
+private:
+    std::atomic<int> signalled { 0 };
+
+   #if JUCE_MAC
+    void* semaphore = nullptr;
+   #elif ! (JUCE_LINUX || JUCE_WINDOWS)
+    juce::WaitableEvent event;
+   #endif
+};
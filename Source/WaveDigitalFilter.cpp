@@ -1,5 +1,41 @@
 #include "WaveDigitalFilter.h"
 
+// The shaper is tanh(k x) with k depending on the sign of x, so both the
+// lookup and the antiderivatives follow from the tanh table by rescaling.
+// k is picked per lane with a mask.
+template <bool tabulated>
+struct WaveDigitalFilter::TanhShaper
+{
+    const AntiderivativeTable& table;
+    double drive;
+    
+    Lanes scale(Lanes x) const
+    {
+        return LaneMath::select(Lanes::greaterThan(x, Lanes::expand(0.0)),
+                                Lanes::expand(drive * 0.95), Lanes::expand(drive * 1.05));
+    }
+    
+    Lanes value(Lanes x) const
+    {
+        if constexpr (tabulated)
+            return table.function(scale(x) * x);
+        else
+            return LaneMath::applyLanewise(x, [this](double v) { return nonlinearFunction(v, drive); });
+    }
+    
+    Lanes first(Lanes x) const
+    {
+        const Lanes k = scale(x);
+        return LaneMath::divide(table.firstAntiderivative(k * x), k);
+    }
+    
+    Lanes second(Lanes x) const
+    {
+        const Lanes k = scale(x);
+        return LaneMath::divide(table.secondAntiderivative(k * x), k * k);
+    }
+};
+
 WaveDigitalFilter::WaveDigitalFilter()
 {
 }
@@ -7,92 +43,127 @@ WaveDigitalFilter::WaveDigitalFilter()
 void WaveDigitalFilter::prepare(double sampleRate)
 {
     this->sampleRate = sampleRate;
+    
+    // Make sure the shared table exists before the audio thread needs it
+    getAntiderivativeTable();
+    
+    nonlinearitySmoothed.reset(sampleRate, rampTimeSeconds);
+    nonlinearitySmoothed.setCurrentAndTargetValue(nonlinearity);
+    circuit.prepare(sampleRate);
     reset();
 }
 
 void WaveDigitalFilter::reset()
 {
-    a1 = 0.0;
-    b1 = 0.0;
-    capacitorState = 0.0;
+    circuit.reset();
+    antialiasingState.reset();
 }
 
-float WaveDigitalFilter::processSample(float input)
+void WaveDigitalFilter::setUseLookupTables(bool shouldUseTables)
 {
-    // Convert voltage to wave variable
-    double voltage = static_cast<double>(input);
-    
-    // Incident wave: a = v + i*R
-    // For simplicity, we model a series RC circuit
-    double R_eff = R;
-    double Z = R_eff;  // Impedance
-    
-    // Calculate incident wave
-    a1 = voltage + (voltage / Z) * R_eff;
-    
-    // Apply nonlinearity to the wave
-    a1 = nonlinearFunction(a1);
-    
-    // Scattering operation (reflection)
-    b1 = adaptorScattering(a1);
-    
-    // Convert back to voltage: v = (a + b) / 2
-    double output = (a1 + b1) * 0.5;
+    useLookupTables = shouldUseTables;
+}
+
+void WaveDigitalFilter::processBlock(const Lanes* input, Lanes* output, int numSamples)
+{
+    // Port resistances and adaptor coefficients are only recomputed for
+    // components that changed since the last block
+    circuit.updateImpedance();
     
-    // Apply capacitor smoothing (low-pass effect)
-    double alpha = 1.0 / (1.0 + 2.0 * juce::MathConstants<double>::pi * C * R * sampleRate);
-    capacitorState = alpha * output + (1.0 - alpha) * capacitorState;
-    output = capacitorState;
+    if (useLookupTables)
+        processBlockWith<true>(input, output, numSamples);
+    else
+        processBlockWith<false>(input, output, numSamples);
+}
+
+template <bool tabulated>
+void WaveDigitalFilter::processBlockWith(const Lanes* input, Lanes* output, int numSamples)
+{
+    switch (antialiasingMode)
+    {
+        case AntialiasingMode::Off:
+            processBlockWith<AntialiasingMode::Off, tabulated>(input, output, numSamples);
+            break;
+        case AntialiasingMode::FirstOrder:
+            processBlockWith<AntialiasingMode::FirstOrder, tabulated>(input, output, numSamples);
+            break;
+        case AntialiasingMode::SecondOrder:
+            processBlockWith<AntialiasingMode::SecondOrder, tabulated>(input, output, numSamples);
+            break;
+    }
+}
+
+template <AntialiasingMode mode, bool tabulated>
+void WaveDigitalFilter::processBlockWith(const Lanes* input, Lanes* output, int numSamples)
+{
+    const auto& table = getAntiderivativeTable();
     
-    return static_cast<float>(output);
+    for (int i = 0; i < numSamples; ++i)
+    {
+        // Drive stage (drive from 1 to 10) into the source voltage
+        double drive = 1.0 + nonlinearitySmoothed.getNextValue() * 9.0;
+        source().setVoltage(ADAA::process<mode>(input[i] * 2.0, antialiasingState,
+                                                TanhShaper<tabulated> { table, drive }));
+        
+        // Scatter through the tree and read the voltage across the diodes
+        circuit.process();
+        
+        output[i] = circuit.voltage();
+    }
 }
 
 void WaveDigitalFilter::setResistance(double R)
 {
     this->R = R;
+    source().setResistance(R);
 }
 
 void WaveDigitalFilter::setCapacitance(double C)
 {
     this->C = C;
+    capacitor().setCapacitance(C);
 }
 
 void WaveDigitalFilter::setInductance(double L)
 {
     this->L = L;
+    inductor().setInductance(L);
 }
 
 void WaveDigitalFilter::setNonlinearity(double nonlinearity)
 {
     this->nonlinearity = juce::jlimit(0.0, 1.0, nonlinearity);
+    nonlinearitySmoothed.setTargetValue(this->nonlinearity);
 }
 
-double WaveDigitalFilter::adaptorScattering(double incident)
+void WaveDigitalFilter::setAntialiasingMode(AntialiasingMode mode)
 {
-    // Series adaptor scattering matrix
-    // For a series connection, reflection coefficient depends on impedances
-    double Z1 = R;
-    double Z2 = 1.0 / (2.0 * juce::MathConstants<double>::pi * C * sampleRate);
+    if (mode == antialiasingMode)
+        return;
     
-    double gamma = (Z1 - Z2) / (Z1 + Z2);
-    return gamma * incident;
+    antialiasingMode = mode;
+    antialiasingState.reset();
 }
 
-double WaveDigitalFilter::nonlinearFunction(double x)
+double WaveDigitalFilter::nonlinearFunction(double x, double drive)
 {
-    // Soft saturation using hyperbolic tangent with adjustable curve
-    double drive = 1.0 + nonlinearity * 9.0;  // Drive from 1 to 10
-    double saturated = std::tanh(x * drive);
-    
-    // Add subtle asymmetry for more analog character
-    if (x > 0.0)
-    {
-        saturated = std::tanh(x * drive * 0.95);
-    }
-    else
+    // Soft saturation using hyperbolic tangent with adjustable curve,
+    // with subtle asymmetry for more analog character
+    double asymmetry = x > 0.0 ? 0.95 : 1.05;
+    return std::tanh(x * drive * asymmetry);
+}
+
+const AntiderivativeTable& WaveDigitalFilter::getAntiderivativeTable()
+{
+    static const AntiderivativeTable tanhTable = []
     {
-        saturated = std::tanh(x * drive * 1.05);
-    }
+        AntiderivativeTable table([](double x) { return std::tanh(x); }, 24.0, 64);
+        
+        // Interpolation error bound, checked against std::tanh
+        jassert (table.getMaxError() < 1.0e-8);
+        
+        return table;
+    }();
     
-    return saturated;
+    return tanhTable;
 }
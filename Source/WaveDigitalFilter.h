@@ -1,6 +1,9 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "AntiderivativeAntialiasing.h"
+#include "LaneMath.h"
+#include "WaveDigitalTree.h"
 #include <cmath>
 #include <complex>
 
@@ -8,6 +11,12 @@
  * Wave Digital Filter (WDF) implementation for analog circuit modeling.
  * WDFs provide a powerful framework for modeling analog circuits digitally
  * while maintaining their topology and behavior.
+ *
+ * The modelled circuit is a diode clipper: a tanh drive stage feeds a source
+ * resistance and series inductance into a capacitor shunted by an
+ * antiparallel pair of silicon diode strings.
+ *
+ * Each SIMD lane carries one independent audio channel.
  */
 class WaveDigitalFilter
 {
@@ -18,32 +27,74 @@ public:
     void prepare(double sampleRate);
     void reset();
     
-    // Process sample through WDF circuit
-    float processSample(float input);
+    using Lanes = LaneMath::Lanes;
+    
+    // Process a block of lane vectors; parameter changes are ramped across the block
+    void processBlock(const Lanes* input, Lanes* output, int numSamples);
     
     // Set circuit parameters
     void setResistance(double R);
     void setCapacitance(double C);
     void setInductance(double L);
     void setNonlinearity(double nonlinearity);
+    void setAntialiasingMode(AntialiasingMode mode);
+    
+    // Evaluate the shaper from the shared tanh table (default) or std::tanh
+    void setUseLookupTables(bool shouldUseTables);
 
 private:
     double sampleRate = 44100.0;
     
-    // WDF adaptor parameters
-    double R = 1000.0;  // Resistance
-    double C = 1e-6;    // Capacitance
-    double L = 1e-3;    // Inductance
+    // Circuit component values
+    double R = 2200.0;  // Source resistance
+    double C = 10e-9;   // Shunt capacitance
+    double L = 1e-3;    // Series inductance
+    
+    // 1N4148-style diodes, two in series on each side of the pair
+    static constexpr double diodeSaturationCurrent = 2.52e-9;
+    static constexpr double diodeThermalVoltage = 25.85e-3;
+    static constexpr double diodesPerString = 2.0;
     
-    // State variables
-    double a1 = 0.0;  // Incident wave
-    double b1 = 0.0;  // Reflected wave
-    double capacitorState = 0.0;  // Capacitor smoothing state (per-instance)
+    // The static circuit tree: source and inductor in series, in parallel
+    // with the capacitor, terminated by the diode pair. The series branch is
+    // inverted so the source keeps its polarity across the capacitor.
+    using SourceBranch = WDF::Inverter<WDF::Series<WDF::ResistiveVoltageSource, WDF::Inductor>>;
+    using Circuit = WDF::DiodePair<WDF::Parallel<SourceBranch, WDF::Capacitor>>;
+    
+    Circuit circuit { { SourceBranch { { WDF::ResistiveVoltageSource { R }, WDF::Inductor { L } } },
+                        WDF::Capacitor { C } },
+                      diodeSaturationCurrent, diodeThermalVoltage, diodesPerString };
+    
+    WDF::ResistiveVoltageSource& source() { return circuit.next.port1.next.port1; }
+    WDF::Inductor& inductor() { return circuit.next.port1.next.port2; }
+    WDF::Capacitor& capacitor() { return circuit.next.port2; }
     
     // Nonlinearity parameter
     double nonlinearity = 0.5;
+    juce::SmoothedValue<double> nonlinearitySmoothed;
+    
+    static constexpr double rampTimeSeconds = 0.02;
+    
+    // Anti-aliasing
+    AntialiasingMode antialiasingMode = AntialiasingMode::Off;
+    AntialiasingState antialiasingState;
+    
+    bool useLookupTables = true;
+    
+    // Nonlinearity with its antiderivatives, exact or table-driven
+    template <bool tabulated>
+    struct TanhShaper;
+    
+    // Block loops specialised for table use and ADAA order
+    template <bool tabulated>
+    void processBlockWith(const Lanes* input, Lanes* output, int numSamples);
+    
+    template <AntialiasingMode mode, bool tabulated>
+    void processBlockWith(const Lanes* input, Lanes* output, int numSamples);
     
     // Helper functions
-    double adaptorScattering(double incident);
-    double nonlinearFunction(double x);
+    static double nonlinearFunction(double x, double drive);
+    
+    // tanh with its antiderivatives, shared read-only by all instances
+    static const AntiderivativeTable& getAntiderivativeTable();
 };
@@ -0,0 +1,397 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LaneMath.h"
+#include <cmath>
+#include <utility>
+
+/**
+ * Header-only building blocks for static Wave Digital Filter trees.
+ *
+ * A circuit is written as a nested type, e.g.
+ *
+ *     WDF::DiodePair<WDF::Parallel<WDF::ResistiveVoltageSource, WDF::Capacitor>>
+ *
+ * Adaptors own their children by value, so the whole tree is one object with
+ * its structure fixed at compile time and every scattering call inlined.
+ * Wave variables are lane vectors (one channel per lane); port resistances are
+ * shared by all lanes.
+ *
+ * Component setters only mark a port as changed. updateImpedance() walks the
+ * tree once per block and recomputes resistances and adaptor coefficients on
+ * the changed branches only, so the per-sample work is the bare scattering.
+ */
+namespace WDF
+{
+    using Lanes = LaneMath::Lanes;
+
+    // Port state shared by every element: resistance and the wave pair seen
+    // from the parent (a travels into the element, b travels out of it)
+    struct Port
+    {
+        double R = 1.0;
+        double G = 1.0;
+        Lanes a = Lanes::expand(0.0);
+        Lanes b = Lanes::expand(0.0);
+
+        Lanes voltage() const { return (a + b) * 0.5; }
+        Lanes current() const { return (a - b) * (0.5 * G); }
+
+    protected:
+        bool impedanceChanged = true;
+
+        void setPortResistance(double newR)
+        {
+            if (newR == R && ! impedanceChanged)
+                return;
+
+            R = newR;
+            G = 1.0 / newR;
+            impedanceChanged = true;
+        }
+
+        bool takeImpedanceChange() { return std::exchange(impedanceChanged, false); }
+    };
+
+    //==============================================================================
+    class Resistor : public Port
+    {
+    public:
+        explicit Resistor(double resistance) { setResistance(resistance); }
+
+        void setResistance(double resistance) { setPortResistance(resistance); }
+
+        void prepare(double) {}
+        void reset() {}
+        bool updateImpedance() { return takeImpedanceChange(); }
+
+        forcedinline void incident(Lanes x) { a = x; }
+        forcedinline Lanes reflected() { b = Lanes::expand(0.0); return b; }
+    };
+
+    // Capacitor discretised with the bilinear transform: R = 1 / (2 C fs)
+    class Capacitor : public Port
+    {
+    public:
+        explicit Capacitor(double capacitance) { setCapacitance(capacitance); }
+
+        void setCapacitance(double capacitance)
+        {
+            C = capacitance;
+            setPortResistance(1.0 / (2.0 * C * sampleRate));
+        }
+
+        void prepare(double newSampleRate)
+        {
+            sampleRate = newSampleRate;
+            setCapacitance(C);
+        }
+
+        void reset() { state = Lanes::expand(0.0); }
+        bool updateImpedance() { return takeImpedanceChange(); }
+
+        forcedinline void incident(Lanes x)
+        {
+            a = x;
+            state = a;
+        }
+
+        forcedinline Lanes reflected() { b = state; return b; }
+
+    private:
+        double C = 0.0;
+        double sampleRate = 44100.0;
+        Lanes state = Lanes::expand(0.0);
+    };
+
+    // Inductor discretised with the bilinear transform: R = 2 L fs
+    class Inductor : public Port
+    {
+    public:
+        explicit Inductor(double inductance) { setInductance(inductance); }
+
+        void setInductance(double inductance)
+        {
+            L = inductance;
+            setPortResistance(2.0 * L * sampleRate);
+        }
+
+        void prepare(double newSampleRate)
+        {
+            sampleRate = newSampleRate;
+            setInductance(L);
+        }
+
+        void reset() { state = Lanes::expand(0.0); }
+        bool updateImpedance() { return takeImpedanceChange(); }
+
+        forcedinline void incident(Lanes x)
+        {
+            a = x;
+            state = a;
+        }
+
+        forcedinline Lanes reflected() { b = Lanes::expand(0.0) - state; return b; }
+
+    private:
+        double L = 0.0;
+        double sampleRate = 44100.0;
+        Lanes state = Lanes::expand(0.0);
+    };
+
+    // Ideal voltage source with a series resistance
+    class ResistiveVoltageSource : public Port
+    {
+    public:
+        explicit ResistiveVoltageSource(double resistance) { setResistance(resistance); }
+
+        void setResistance(double resistance) { setPortResistance(resistance); }
+        void setVoltage(Lanes newVoltage) { sourceVoltage = newVoltage; }
+
+        void prepare(double) {}
+        void reset() { sourceVoltage = Lanes::expand(0.0); }
+        bool updateImpedance() { return takeImpedanceChange(); }
+
+        forcedinline void incident(Lanes x) { a = x; }
+        forcedinline Lanes reflected() { b = sourceVoltage; return b; }
+
+    private:
+        Lanes sourceVoltage = Lanes::expand(0.0);
+    };
+
+    //==============================================================================
+    // Three-port series adaptor, adapted towards the parent
+    template <typename Port1, typename Port2>
+    class Series : public Port
+    {
+    public:
+        Series(Port1 p1, Port2 p2) : port1(std::move(p1)), port2(std::move(p2)) {}
+
+        Port1 port1;
+        Port2 port2;
+
+        void prepare(double sampleRate)
+        {
+            port1.prepare(sampleRate);
+            port2.prepare(sampleRate);
+        }
+
+        void reset()
+        {
+            port1.reset();
+            port2.reset();
+        }
+
+        bool updateImpedance()
+        {
+            const bool changed1 = port1.updateImpedance();
+            const bool changed2 = port2.updateImpedance();
+
+            if (changed1 || changed2)
+            {
+                setPortResistance(port1.R + port2.R);
+                port1Reflect = port1.R / R;
+            }
+
+            return takeImpedanceChange();
+        }
+
+        forcedinline void incident(Lanes x)
+        {
+            const Lanes b1 = port1.b - (x + port1.b + port2.b) * port1Reflect;
+            port1.incident(b1);
+            port2.incident(Lanes::expand(0.0) - (x + b1));
+            a = x;
+        }
+
+        forcedinline Lanes reflected()
+        {
+            b = Lanes::expand(0.0) - (port1.reflected() + port2.reflected());
+            return b;
+        }
+
+    private:
+        double port1Reflect = 0.5;
+    };
+
+    // Three-port parallel adaptor, adapted towards the parent
+    template <typename Port1, typename Port2>
+    class Parallel : public Port
+    {
+    public:
+        Parallel(Port1 p1, Port2 p2) : port1(std::move(p1)), port2(std::move(p2)) {}
+
+        Port1 port1;
+        Port2 port2;
+
+        void prepare(double sampleRate)
+        {
+            port1.prepare(sampleRate);
+            port2.prepare(sampleRate);
+        }
+
+        void reset()
+        {
+            port1.reset();
+            port2.reset();
+        }
+
+        bool updateImpedance()
+        {
+            const bool changed1 = port1.updateImpedance();
+            const bool changed2 = port2.updateImpedance();
+
+            if (changed1 || changed2)
+            {
+                setPortResistance(1.0 / (port1.G + port2.G));
+                port1Reflect = port1.G * R;
+            }
+
+            return takeImpedanceChange();
+        }
+
+        forcedinline void incident(Lanes x)
+        {
+            const Lanes b2 = x + bTemp;
+            port1.incident(b2 + bDiff);
+            port2.incident(b2);
+            a = x;
+        }
+
+        forcedinline Lanes reflected()
+        {
+            port1.reflected();
+            port2.reflected();
+
+            bDiff = port2.b - port1.b;
+            bTemp = bDiff * (-port1Reflect);
+            b = port2.b + bTemp;
+            return b;
+        }
+
+    private:
+        double port1Reflect = 0.5;
+        Lanes bDiff = Lanes::expand(0.0);
+        Lanes bTemp = Lanes::expand(0.0);
+    };
+
+    // Two-port polarity inverter, e.g. to flip a branch hanging off a series adaptor
+    template <typename Next>
+    class Inverter : public Port
+    {
+    public:
+        explicit Inverter(Next n) : next(std::move(n)) {}
+
+        Next next;
+
+        void prepare(double sampleRate) { next.prepare(sampleRate); }
+        void reset() { next.reset(); }
+
+        bool updateImpedance()
+        {
+            if (next.updateImpedance())
+                setPortResistance(next.R);
+
+            return takeImpedanceChange();
+        }
+
+        forcedinline void incident(Lanes x)
+        {
+            a = x;
+            next.incident(Lanes::expand(0.0) - x);
+        }
+
+        forcedinline Lanes reflected()
+        {
+            b = Lanes::expand(0.0) - next.reflected();
+            return b;
+        }
+    };
+
+    //==============================================================================
+    // Wright omega function w(x), the solution of w + log(w) = x: a cubic
+    // first guess refined by one Newton step (D'Angelo et al., 2019)
+    inline double wrightOmega(double x)
+    {
+        double w;
+
+        if (x < -3.341459552768620)
+            w = 0.0;
+        else if (x < 8.0)
+            w = 6.313183464296682e-1 + x * (3.631952663804445e-1
+                + x * (4.775931364975583e-2 + x * -1.314293149877800e-3));
+        else
+            w = x - std::log(x);
+
+        return w - (w - std::exp(x - w)) / (w + 1.0);
+    }
+
+    /**
+     * Antiparallel diode pair at the root of a tree, solved explicitly with
+     * the Wright omega function (Werner et al., 2015). numDiodes scales the
+     * thermal voltage for series strings.
+     */
+    template <typename Next>
+    class DiodePair
+    {
+    public:
+        DiodePair(Next n, double saturationCurrent, double thermalVoltage = 25.85e-3, double numDiodes = 1.0)
+            : next(std::move(n)),
+              Is(saturationCurrent),
+              Vt(thermalVoltage * numDiodes)
+        {
+        }
+
+        Next next;
+
+        void prepare(double sampleRate)
+        {
+            next.prepare(sampleRate);
+            updateImpedance();
+        }
+
+        void reset()
+        {
+            next.reset();
+            a = Lanes::expand(0.0);
+            b = Lanes::expand(0.0);
+        }
+
+        void updateImpedance()
+        {
+            if (! next.updateImpedance())
+                return;
+
+            const double RIs = next.R * Is;
+            RIsOverVt = RIs / Vt;
+            logRIsOverVt = std::log(RIsOverVt);
+        }
+
+        // One sample of the whole tree: gather waves up, scatter them back down
+        forcedinline void process()
+        {
+            a = next.reflected();
+            b = LaneMath::applyLanewise(a, [this](double x) { return reflect(x); });
+            next.incident(b);
+        }
+
+        Lanes voltage() const { return (a + b) * 0.5; }
+
+    private:
+        double Is;
+        double Vt;
+        double RIsOverVt = 0.0;
+        double logRIsOverVt = 0.0;
+
+        Lanes a = Lanes::expand(0.0);
+        Lanes b = Lanes::expand(0.0);
+
+        double reflect(double x) const
+        {
+            const double magnitude = std::abs(x) / Vt;
+            const double base = logRIsOverVt + RIsOverVt;
+            const double delta = wrightOmega(base + magnitude) - wrightOmega(base - magnitude);
+            return x - std::copysign(2.0 * Vt * delta, x);
+        }
+    };
+}
@@ -0,0 +1,92 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int numWorkers)
+{
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>(*this));
+        workers.back()->startRealtimeThread(juce::Thread::RealtimeOptions {});
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    for (auto& worker : workers)
+    {
+        worker->signalThreadShouldExit();
+        worker->wakeSignal.notify();
+    }
+
+    for (auto& worker : workers)
+    {
+        worker->stopThread(1000);
+    }
+}
+
+void WorkerPool::runTasks(int numTasks, TaskFunction function, void* context)
+{
+    if (numTasks <= 0)
+        return;
+
+    // The previous job has fully drained, so nobody reads these any more
+    taskFunction = function;
+    taskContext = context;
+    remainingTasks.store(numTasks, std::memory_order_relaxed);
+    claim.store(static_cast<juce::uint64>(numTasks) << 32, std::memory_order_release);
+
+    // The caller takes one share itself
+    const int numToWake = juce::jmin(getNumWorkers(), numTasks - 1);
+    for (int i = 0; i < numToWake; ++i)
+    {
+        workers[static_cast<size_t>(i)]->wakeSignal.notify();
+    }
+
+    while (runNextTask())
+    {
+    }
+
+    // Only tasks already running on a worker are left
+    while (remainingTasks.load(std::memory_order_acquire) > 0)
+    {
+    }
+}
+
+bool WorkerPool::runNextTask()
+{
+    auto current = claim.load(std::memory_order_acquire);
+
+    for (;;)
+    {
+        const auto numTasks = current >> 32;
+        const auto index = current & 0xffffffffu;
+
+        if (index >= numTasks)
+            return false;
+
+        // A successful swap claims the index within the job it was read from,
+        // and makes that job's function and context visible
+        if (claim.compare_exchange_weak(current, current + 1,
+                                        std::memory_order_acquire, std::memory_order_acquire))
+        {
+            taskFunction(taskContext, static_cast<int>(index));
+            remainingTasks.fetch_sub(1, std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+//==============================================================================
+WorkerPool::Worker::Worker(WorkerPool& owner)
+    : juce::Thread("Saturation worker"),
+      pool(owner)
+{
+}
+
+void WorkerPool::Worker::run()
+{
+    while (! threadShouldExit())
+    {
+        if (! pool.runNextTask())
+            wakeSignal.wait();
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "WakeSignal.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * A small pool of real-time worker threads for splitting one block of work
+ * across cores.
+ *
+ * run() hands out task indices from a single atomic counter. The calling
+ * thread claims tasks as well, so a worker that wakes late only reduces the
+ * parallelism and never stalls the block; the caller only waits for tasks
+ * that a worker has already started. Nothing on the calling side allocates
+ * or takes a lock, and waking a worker is a non-blocking kernel call (a
+ * futex on Linux, an address wait on Windows, a dispatch semaphore on macOS).
+ *
+ * Threads are started in the constructor and stopped in the destructor, so
+ * the pool should be built and destroyed off the audio thread.
+ */
+class WorkerPool
+{
+public:
+    explicit WorkerPool(int numWorkers);
+    ~WorkerPool();
+
+    int getNumWorkers() const { return static_cast<int>(workers.size()); }
+
+    // Call task(index) for every index in [0, numTasks) and return once all
+    // of them have finished. Only one thread may call run() at a time.
+    template <typename Task>
+    void run(int numTasks, Task& task)
+    {
+        runTasks(numTasks, [](void* context, int index) { (*static_cast<Task*>(context))(index); }, &task);
+    }
+
+private:
+    using TaskFunction = void (*)(void* context, int index);
+
+    class Worker : public juce::Thread
+    {
+    public:
+        explicit Worker(WorkerPool& owner);
+        void run() override;
+
+        WakeSignal wakeSignal;
+
+    private:
+        WorkerPool& pool;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // The current job. The claim word packs the task count (high half) with
+    // the next unclaimed index (low half), so a claim is a single
+    // compare-and-swap against the job it belongs to.
+    TaskFunction taskFunction = nullptr;
+    void* taskContext = nullptr;
+    std::atomic<juce::uint64> claim { 0 };
+    std::atomic<int> remainingTasks { 0 };
+
+    void runTasks(int numTasks, TaskFunction function, void* context);
+
+    // Claim and run one task of the current job, returns false if none is left
+    bool runNextTask();
+};
@@ -17,6 +17,8 @@ public:
     Steinberg::tresult PLUGIN_API terminate() SMTG_OVERRIDE;
 
     Steinberg::tresult PLUGIN_API setComponentState(Steinberg::IBStream* state) SMTG_OVERRIDE;
+    Steinberg::tresult PLUGIN_API setParamNormalized(Steinberg::Vst::ParamID tag,
+                                                     Steinberg::Vst::ParamValue value) SMTG_OVERRIDE;
 };
 
 } // namespace analog
@@ -20,9 +20,14 @@ enum ParamIds : Steinberg::Vst::ParamID {
     kDynamics,
     kSlew,
     kQuality,
-    kBypass
+    kBypass,
+    // Read-only, sent by the processor once it has switched to a new
+    // oversampling latency: latency / kMaxLatencySamples
+    kLatency
 };
 
-inline constexpr Steinberg::int32 kNumParameters = 9;
+inline constexpr Steinberg::int32 kNumParameters = 10;
+
+inline constexpr double kMaxLatencySamples = 64.0;
 
 } // namespace analog::ids
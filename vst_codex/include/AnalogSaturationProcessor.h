@@ -1,6 +1,7 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <vector>
 
 #include "pluginterfaces/vst/ivstaudioprocessor.h"
@@ -24,25 +25,59 @@ public:
     Steinberg::tresult PLUGIN_API getState(Steinberg::IBStream* state) SMTG_OVERRIDE;
 
     Steinberg::tresult PLUGIN_API setupProcessing(Steinberg::Vst::ProcessSetup& setup) SMTG_OVERRIDE;
+    Steinberg::tresult PLUGIN_API setActive(Steinberg::TBool state) SMTG_OVERRIDE;
     Steinberg::tresult PLUGIN_API process(Steinberg::Vst::ProcessData& data) SMTG_OVERRIDE;
     Steinberg::tresult PLUGIN_API setBusArrangements(Steinberg::Vst::SpeakerArrangement* inputs,
                                                      Steinberg::int32 numIns,
                                                      Steinberg::Vst::SpeakerArrangement* outputs,
                                                      Steinberg::int32 numOuts) SMTG_OVERRIDE;
+    Steinberg::uint32 PLUGIN_API getLatencySamples() SMTG_OVERRIDE;
+    Steinberg::tresult PLUGIN_API canProcessSampleSize(Steinberg::int32 symbolicSampleSize) SMTG_OVERRIDE;
 
     static Steinberg::FUnknown* createInstance(void*) { return static_cast<Steinberg::Vst::IAudioProcessor*>(new AnalogSaturationProcessor()); }
 
 private:
     void syncModelWithParameters();
+
+    // Hands settings to both precisions and refreshes the reported latency
+    void applySettings(const dsp::SaturationSettings& settings);
+
+    // Applies settings left by setState(), if any; audio thread, or while
+    // inactive
+    void applyPendingState();
+
     void updateSmoothing(Steinberg::Vst::SampleRate sampleRate);
 
-    dsp::SaturationModel model_;
+    // Sets the target of a parameter from its normalized value
+    void applyParameterChange(Steinberg::Vst::ParamID id, Steinberg::Vst::ParamValue value);
+
+    // Sends a latency change to the controller once it has taken effect, so
+    // the restart it asks for finds the new latency in place
+    void reportLatency(Steinberg::Vst::IParameterChanges* outputs);
+
+    // Renders [offset, offset + numSamples) of the block, in short segments
+    // while any parameter is still smoothing
+    void processSubBlock(Steinberg::Vst::ProcessData& data, Steinberg::int32 offset, Steinberg::int32 numSamples);
+
+    template <typename SampleType>
+    void renderSubBlock(dsp::SaturationModel<SampleType>& model, SampleType** inputs, SampleType** outputs,
+                        Steinberg::int32 numChannels, Steinberg::int32 offset, Steinberg::int32 numSamples);
+
+    // One model per host precision; only the one in use is prepared, but
+    // both always hold the same settings
+    dsp::SaturationModel<float> model32_;
+    dsp::SaturationModel<double> model64_;
+    bool use64Bit_ {false};
+    // Channels of the negotiated layout, the same on input and output
+    Steinberg::int32 numChannels_ {2};
 
     struct SmoothedValue {
         void setTime(double timeMs, double sampleRate);
         void setCurrent(float value);
         void setTarget(float value);
-        float getNext();
+        // Advances numSamples samples at once
+        void skip(Steinberg::int32 numSamples);
+        bool isSmoothing() const { return current != target; }
 
         double coeff {0.0};
         float current {0.0F};
@@ -58,11 +93,18 @@ private:
     SmoothedValue slew_;
 
     float bypass_ {0.0F};
+    // The model's oversampling latency, read by the host off the audio thread
+    std::atomic<Steinberg::uint32> latencySamples_ {0};
+    // The latency last sent to the controller; audio thread only
+    Steinberg::uint32 reportedLatency_ {0};
+    // Settings decoded by setState(), which the host may call on its UI
+    // thread while process() runs. The lock only guards the copy: setState()
+    // spins on it, the audio thread tries once and otherwise waits a block.
+    dsp::SaturationSettings pendingSettings_ {};
+    std::atomic<bool> statePending_ {false};
+    std::atomic_flag pendingSettingsLock_ = ATOMIC_FLAG_INIT;
     double sampleRate_ {44100.0};
     Steinberg::Vst::ProcessSetup setup_ {};
-
-    std::array<std::vector<float>, 2> tempIn_ {};
-    std::array<std::vector<float>, 2> tempOut_ {};
 };
 
 } // namespace analog
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+
+#include "pluginterfaces/base/ibstream.h"
+
+#include "dsp/SaturationModel.h"
+
+namespace analog::state {
+
+// The component state: a tag and a version, then the settings as stored by
+// the model. The first release wrote the bare settings with no header; its
+// Quality list was Eco and High, so 1.0 meant 4x where it now means 16x.
+// Read as a float the tag is about 4e12, far outside a stored drive.
+inline constexpr Steinberg::uint32 kTag = 0x54534341; // "ACST"
+inline constexpr Steinberg::uint32 kVersion = 2;
+
+struct Header {
+    Steinberg::uint32 tag = kTag;
+    Steinberg::uint32 version = kVersion;
+};
+
+inline bool write(Steinberg::IBStream* stream, const dsp::SaturationSettings& settings)
+{
+    if (!stream) {
+        return false;
+    }
+
+    std::array<char, sizeof(Header) + sizeof(dsp::SaturationSettings)> bytes {};
+    const Header header {};
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + sizeof(header), &settings, sizeof(settings));
+
+    Steinberg::int32 numWritten = 0;
+    return stream->write(bytes.data(), static_cast<Steinberg::int32>(bytes.size()), &numWritten) == Steinberg::kResultTrue
+           && numWritten == static_cast<Steinberg::int32>(bytes.size());
+}
+
+// Reads either format into settings, mapping a first-release Quality onto
+// the four-step list. Leaves settings untouched and returns false if the
+// stream is too short for either.
+inline bool read(Steinberg::IBStream* stream, dsp::SaturationSettings& settings)
+{
+    if (!stream) {
+        return false;
+    }
+
+    std::array<char, sizeof(Header) + sizeof(dsp::SaturationSettings)> bytes {};
+    Steinberg::int32 numRead = 0;
+    if (stream->read(bytes.data(), static_cast<Steinberg::int32>(bytes.size()), &numRead) != Steinberg::kResultTrue) {
+        return false;
+    }
+
+    Header header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    if (header.tag == kTag) {
+        if (numRead < static_cast<Steinberg::int32>(bytes.size())) {
+            return false;
+        }
+        std::memcpy(&settings, bytes.data() + sizeof(header), sizeof(settings));
+        return true;
+    }
+
+    if (numRead < static_cast<Steinberg::int32>(sizeof(settings))) {
+        return false;
+    }
+    std::memcpy(&settings, bytes.data(), sizeof(settings));
+
+    // Eco ran at 2x and High at 4x
+    settings.quality = settings.quality >= 0.5F ? 1.0F / 3.0F : 0.0F;
+    return true;
+}
+
+} // namespace analog::state
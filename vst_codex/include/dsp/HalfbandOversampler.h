@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+namespace analog::dsp {
+
+// Up to 16x oversampling
+inline constexpr int kMaxHalfbandStages = 4;
+
+// One polyphase FIR halfband stage: doubles the sample rate on the way up and
+// halves it on the way down, each direction with its own filter state.
+//
+// Every other tap of a halfband filter is zero and the centre tap is 1/2, so
+// each direction splits into a dense branch of numCoefficients taps and a
+// pure delay. The dense branch runs tap by tap over the whole block, which
+// keeps the inner loop a contiguous multiply-add the compiler vectorizes.
+template <typename SampleType>
+class HalfbandStage {
+public:
+    // numCoefficients is the length of the dense branch, a multiple of 4
+    void prepare(int numCoefficients, int maxInputSamples);
+    void reset();
+
+    // Writes 2 * numSamples samples
+    void upsample(const SampleType* input, SampleType* output, int numSamples);
+
+    // Reads 2 * numSamples samples; output must not overlap input
+    void downsample(const SampleType* input, SampleType* output, int numSamples);
+
+    // Delay of the filter in one direction, in samples at the upper rate
+    int getDelay() const { return numCoefficients_ - 1; }
+
+private:
+    int numCoefficients_ = 0;
+    std::vector<SampleType> coefficients_;
+
+    // Each buffer holds the filter history followed by the current block
+    std::vector<SampleType> upBuffer_;
+    std::vector<SampleType> downEven_;
+    std::vector<SampleType> downOdd_;
+    std::vector<SampleType> branch_;
+};
+
+// Cascade of halfband stages for 2x to 16x oversampling. The first stage
+// carries the steepest filter; later stages only have to reject images far
+// above the audio band and get by with far fewer taps.
+template <typename SampleType>
+class HalfbandOversampler {
+public:
+    static constexpr int kMaxStages = kMaxHalfbandStages;
+
+    void prepare(int maxBlockSize);
+    void reset();
+
+    // Selects 2^numStages oversampling; clears the filters if it changes
+    void setNumStages(int numStages);
+    int getFactor() const { return 1 << numStages_; }
+
+    // Round-trip delay in base-rate samples. The cascade is padded with a
+    // short delay at the top rate so this is a whole number.
+    int getLatencySamples() const { return latencySamples_; }
+
+    // Returns numSamples * getFactor() samples at the top rate, valid until
+    // the next call; process them in place, then call downsample.
+    SampleType* upsample(const SampleType* input, int numSamples);
+    void downsample(SampleType* output, int numSamples);
+
+private:
+    void updateLatency();
+
+    std::array<HalfbandStage<SampleType>, kMaxStages> stages_ {};
+    int numStages_ = 1;
+    int maxBlockSize_ = 0;
+
+    std::vector<SampleType> bufferA_;
+    std::vector<SampleType> bufferB_;
+    SampleType* oversampled_ = nullptr;
+
+    static constexpr int kAlignmentSize = 16;
+    std::array<SampleType, kAlignmentSize> alignment_ {};
+    int alignmentDelay_ = 0;
+    int alignmentPosition_ = 0;
+    int latencySamples_ = 0;
+};
+
+extern template class HalfbandStage<float>;
+extern template class HalfbandStage<double>;
+extern template class HalfbandOversampler<float>;
+extern template class HalfbandOversampler<double>;
+
+} // namespace analog::dsp
@@ -3,6 +3,9 @@
 #include <array>
 #include <cmath>
 #include <cstdint>
+#include <vector>
+
+#include "dsp/HalfbandOversampler.h"
 
 namespace analog::dsp {
 
@@ -14,39 +17,105 @@ struct SaturationSettings {
     float outputTrim = 0.0F;
     float dynamics = 0.5F;
     float slew = 0.5F;
-    float quality = 1.0F; // 0 = eco, 1 = high
+    float quality = 1.0F / 3.0F; // 0, 1/3, 2/3, 1 = 2x, 4x, 8x, 16x oversampling
     float bypass = 0.0F;  // 0 = off, 1 = on
 };
 
+// Oversampling factor for a quality setting: 2x, 4x, 8x or 16x
+int getOversamplingFactor(float quality);
+
+// The saturation model at the host's sample precision. Both precisions are
+// compiled; the settings are single precision either way.
+//
+// Any number of channels is supported. Per-channel state is kept as one array
+// per quantity, and the waveshaper and slew limiter run channels side by side
+// as SIMD lanes: a stereo pair as one group of two, wider layouts in groups of
+// up to eight.
+template <typename SampleType>
 class SaturationModel {
 public:
-    void prepare(double sampleRate, int maxBlockSize);
+    // Allocates every buffer process() needs for blocks up to maxBlockSize
+    // and up to numChannels channels
+    void prepare(double sampleRate, int maxBlockSize, int numChannels = 2);
     void reset();
 
+    // The new settings are reached by the end of the next process() call,
+    // ramping from the ones in use
     void setSettings(const SaturationSettings& s);
     const SaturationSettings& getSettings() const { return settings_; }
 
-    void process(float** inputs, float** outputs, int32_t numChannels, int32_t numSamples);
+    void process(SampleType** inputs, SampleType** outputs, int32_t numChannels, int32_t numSamples);
+
+    // Passes the input through delayed by the latency, so the output stays
+    // aligned while bypassed
+    void processBypassed(SampleType** inputs, SampleType** outputs, int32_t numChannels, int32_t numSamples);
+
+    int getLatencySamples() const { return oversamplers_.empty() ? 0 : oversamplers_[0].getLatencySamples(); }
 
 private:
-    float processSample(float in, size_t channel);
-    float waveshaper(float x, size_t channel);
-    float slewLimit(float x, size_t channel);
+    // Everything the sample loops need from the settings, derived once per
+    // block. Gains ramp exponentially, the rest linearly.
+    struct Coefficients {
+        SampleType inputGain = 1;  // pre-emphasis and drive
+        SampleType bias = 0;
+        SampleType memoryFeedback = 0;
+        SampleType evenDrive = 1;
+        SampleType oddWeight = 1;
+        SampleType evenWeight = 0;
+        SampleType memoryBlend = 0;
+        SampleType maxStep = 0;    // slew limit per oversampled sample
+        SampleType mix = 1;
+        SampleType outputGain = 1;
 
-    struct SlewState {
-        float prev = 0.0F;
+        bool operator==(const Coefficients&) const = default;
     };
 
-    struct HysteresisState {
-        float memory = 0.0F;
+    Coefficients makeCoefficients(const SaturationSettings& s) const;
+
+    // Per-sample step from start to end over numSamples samples
+    static Coefficients makeStep(const Coefficients& start, const Coefficients& end, int32_t numSamples);
+    static void advance(Coefficients& c, const Coefficients& step);
+
+    // Renders [offset, offset + numSamples) of Lanes channels from
+    // firstChannel, ramping from start; returns the coefficients reached.
+    // step is null when not ramping.
+    template <int Lanes>
+    Coefficients processGroup(SampleType** inputs, SampleType** outputs, int32_t firstChannel, int32_t offset,
+                              int32_t numSamples, const Coefficients& start, const Coefficients* step);
+
+    // One oversampled frame of the waveshaper and slew limiter, every lane in
+    // place; the lane loop is the one the compiler vectorizes
+    template <int Lanes>
+    static void saturate(std::array<SampleType, Lanes>& x, std::array<SampleType, Lanes>& memory,
+                         std::array<SampleType, Lanes>& slew, const Coefficients& c);
+
+    SampleType delayDry(SampleType x, size_t channel);
+
+    // Delays the dry signal by the oversampling latency for the mix
+    struct DryDelay {
+        static constexpr int kSize = 64;
+        std::array<SampleType, kSize> buffer {};
+        int position = 0;
     };
 
     double sampleRate_ = 44100.0;
-    int oversampleFactor_ = 2;
+    int maxBlockSize_ = 0;
+    int numChannels_ = 0;
     SaturationSettings settings_ {};
-    std::array<SlewState, 2> slew_ {};
-    std::array<HysteresisState, 2> hysteresis_ {};
-    std::array<float, 2> lastInput_ {0.0F, 0.0F};
+    Coefficients current_ {};
+    Coefficients target_ {};
+
+    // Per-channel state, indexed by channel
+    std::vector<SampleType> slew_;
+    std::vector<SampleType> hysteresis_;
+    std::vector<HalfbandOversampler<SampleType>> oversamplers_;
+    std::vector<DryDelay> dryDelay_;
+
+    std::vector<SampleType> driven_;
+    std::vector<SampleType> wet_;
 };
 
+extern template class SaturationModel<float>;
+extern template class SaturationModel<double>;
+
 } // namespace analog::dsp
@@ -1,7 +1,7 @@
 #include "AnalogSaturationController.h"
 
+#include "AnalogSaturationState.h"
 #include "dsp/SaturationModel.h"
-#include "pluginterfaces/base/ibstream.h"
 #include "pluginterfaces/base/ustring.h"
 #include "public.sdk/source/vst/vstparameters.h"
 
@@ -45,14 +45,27 @@ tresult PLUGIN_API AnalogSaturationController::initialize(FUnknown* context)
     slew->setPrecision(2);
     parameters.addParameter(slew);
 
-    auto* quality = new StringListParameter(USTRING("Quality"), ids::kQuality);
-    quality->appendString(USTRING("Eco"));
-    quality->appendString(USTRING("High"));
+    // Oversampling factor. Not automatable: a change clears the filters and
+    // moves the latency, which the host only picks up on restart. The
+    // processor switches in its next process() call and reports the new
+    // latency through kLatency, which is when the restart is requested.
+    auto* quality = new StringListParameter(USTRING("Quality"), ids::kQuality, nullptr, ParameterInfo::kIsList);
+    quality->appendString(USTRING("2x"));
+    quality->appendString(USTRING("4x"));
+    quality->appendString(USTRING("8x"));
+    quality->appendString(USTRING("16x"));
+    quality->getInfo().defaultNormalizedValue = dsp::SaturationSettings {}.quality;
+    quality->setNormalized(dsp::SaturationSettings {}.quality);
     parameters.addParameter(quality);
 
     auto* bypass = new RangeParameter(USTRING("Bypass"), ids::kBypass, nullptr, 0.0, 1.0, 0.0, 0, ParameterInfo::kIsBypass);
     parameters.addParameter(bypass);
 
+    auto* latency = new RangeParameter(USTRING("Latency"), ids::kLatency, USTRING("samples"), 0.0,
+                                       ids::kMaxLatencySamples, 0.0, 0,
+                                       ParameterInfo::kIsReadOnly | ParameterInfo::kIsHidden);
+    parameters.addParameter(latency);
+
     return kResultOk;
 }
 
@@ -61,6 +74,19 @@ tresult PLUGIN_API AnalogSaturationController::terminate()
     return EditControllerEx1::terminate();
 }
 
+tresult PLUGIN_API AnalogSaturationController::setParamNormalized(ParamID tag, ParamValue value)
+{
+    // Only once the processor runs at the new latency, so the host never
+    // reads the old one on restart
+    const bool latencyChanged = tag == ids::kLatency && value != getParamNormalized(tag);
+
+    tresult result = EditControllerEx1::setParamNormalized(tag, value);
+    if (result == kResultOk && latencyChanged && componentHandler) {
+        componentHandler->restartComponent(kLatencyChanged);
+    }
+    return result;
+}
+
 tresult PLUGIN_API AnalogSaturationController::setComponentState(IBStream* state)
 {
     if (!state) {
@@ -68,7 +94,7 @@ tresult PLUGIN_API AnalogSaturationController::setComponentState(IBStream* state
     }
 
     dsp::SaturationSettings settings {};
-    if (state->read(&settings, sizeof(settings)) == kResultTrue) {
+    if (state::read(state, settings)) {
         setParamNormalized(ids::kDrive, settings.drive);
         setParamNormalized(ids::kBias, (settings.bias + 1.0F) * 0.5F);
         setParamNormalized(ids::kColor, settings.color);
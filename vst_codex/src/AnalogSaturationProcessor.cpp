@@ -3,10 +3,8 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
-#include <cstring>
-#include <type_traits>
 
-#include "pluginterfaces/base/ibstream.h"
+#include "AnalogSaturationState.h"
 
 namespace analog {
 
@@ -15,7 +13,38 @@ using namespace Steinberg::Vst;
 
 namespace {
 constexpr double kSmoothingTimeMs = 15.0;
-}
+
+// Closer than this to its target, a smoothed value snaps onto it
+constexpr float kSettleThreshold = 1.0e-5F;
+
+// While parameters smooth, the model ramps its coefficients linearly over
+// segments this long, tracing the smoothing curve in short straight pieces
+constexpr int32 kMaxRampLength = 32;
+
+// Widest layout accepted, up to 9.1.6 and third-order ambisonics
+constexpr int32 kMaxChannels = 16;
+
+// Walks one parameter queue's points in time order
+struct AutomationCursor {
+    IParamValueQueue* queue = nullptr;
+    int32 numPoints = 0;
+    int32 index = 0;
+    int32 offset = 0;
+    ParamValue value = 0.0;
+
+    // Loads the point at index; false once the queue is exhausted
+    bool load()
+    {
+        while (index < numPoints) {
+            if (queue->getPoint(index, offset, value) == kResultTrue) {
+                return true;
+            }
+            ++index;
+        }
+        return false;
+    }
+};
+} // namespace
 
 AnalogSaturationProcessor::AnalogSaturationProcessor()
 {
@@ -32,7 +61,8 @@ tresult PLUGIN_API AnalogSaturationProcessor::initialize(FUnknown* context)
     addAudioInput(STR16("Input"), SpeakerArr::kStereo);
     addAudioOutput(STR16("Output"), SpeakerArr::kStereo);
 
-    model_.prepare(sampleRate_, 512);
+    model32_.prepare(sampleRate_, 512);
+    applySettings(model32_.getSettings());
 
     drive_.setCurrent(0.5F);
     bias_.setCurrent(0.0F);
@@ -57,10 +87,39 @@ tresult PLUGIN_API AnalogSaturationProcessor::setupProcessing(ProcessSetup& setu
     setup_ = setup;
     sampleRate_ = setup.sampleRate;
     updateSmoothing(sampleRate_);
-    model_.prepare(sampleRate_, static_cast<int>(setup.maxSamplesPerBlock));
+    use64Bit_ = setup.symbolicSampleSize == kSample64;
     return AudioEffect::setupProcessing(setup);
 }
 
+// The host may set the block size, precision and layout in any order while
+// inactive, so the model is prepared once all three are known
+tresult PLUGIN_API AnalogSaturationProcessor::setActive(TBool state)
+{
+    if (state) {
+        const auto maxBlockSize = static_cast<int>(setup_.maxSamplesPerBlock);
+        if (use64Bit_) {
+            model64_.prepare(sampleRate_, maxBlockSize, numChannels_);
+        } else {
+            model32_.prepare(sampleRate_, maxBlockSize, numChannels_);
+        }
+        applySettings(model32_.getSettings());
+        applyPendingState();
+        // The host reads the latency on activation
+        reportedLatency_ = latencySamples_;
+    }
+    return AudioEffect::setActive(state);
+}
+
+uint32 PLUGIN_API AnalogSaturationProcessor::getLatencySamples()
+{
+    return latencySamples_;
+}
+
+tresult PLUGIN_API AnalogSaturationProcessor::canProcessSampleSize(int32 symbolicSampleSize)
+{
+    return symbolicSampleSize == kSample32 || symbolicSampleSize == kSample64 ? kResultTrue : kResultFalse;
+}
+
 tresult PLUGIN_API AnalogSaturationProcessor::setBusArrangements(SpeakerArrangement* inputs,
                                                                  int32 numIns,
                                                                  SpeakerArrangement* outputs,
@@ -70,26 +129,39 @@ tresult PLUGIN_API AnalogSaturationProcessor::setBusArrangements(SpeakerArrangem
         return kResultFalse;
     }
 
-    if (SpeakerArr::getChannelCount(inputs[0]) != 2 || SpeakerArr::getChannelCount(outputs[0]) != 2) {
+    // Any layout from mono to 16 channels, as long as output matches input
+    const int32 numChannels = SpeakerArr::getChannelCount(inputs[0]);
+    if (numChannels < 1 || numChannels > kMaxChannels || SpeakerArr::getChannelCount(outputs[0]) != numChannels) {
         return kResultFalse;
     }
 
-    return AudioEffect::setBusArrangements(inputs, numIns, outputs, numOuts);
+    const tresult result = AudioEffect::setBusArrangements(inputs, numIns, outputs, numOuts);
+    if (result == kResultTrue) {
+        numChannels_ = numChannels;
+    }
+    return result;
 }
 
 void AnalogSaturationProcessor::syncModelWithParameters()
 {
-    dsp::SaturationSettings settings = model_.getSettings();
-    settings.drive = drive_.target;
-    settings.bias = bias_.target;
-    settings.color = color_.target;
-    settings.mix = mix_.target;
-    settings.dynamics = dynamics_.target;
-    settings.slew = slew_.target;
-    settings.outputTrim = outputTrim_.target;
+    dsp::SaturationSettings settings = model32_.getSettings();
+    settings.drive = drive_.current;
+    settings.bias = bias_.current;
+    settings.color = color_.current;
+    settings.mix = mix_.current;
+    settings.dynamics = dynamics_.current;
+    settings.slew = slew_.current;
+    settings.outputTrim = outputTrim_.current;
     settings.quality = std::clamp(settings.quality, 0.0F, 1.0F);
     settings.bypass = bypass_;
-    model_.setSettings(settings);
+    applySettings(settings);
+}
+
+void AnalogSaturationProcessor::applySettings(const dsp::SaturationSettings& settings)
+{
+    model32_.setSettings(settings);
+    model64_.setSettings(settings);
+    latencySamples_ = static_cast<uint32>(use64Bit_ ? model64_.getLatencySamples() : model32_.getLatencySamples());
 }
 
 void AnalogSaturationProcessor::updateSmoothing(Vst::SampleRate sampleRate)
@@ -103,57 +175,60 @@ void AnalogSaturationProcessor::updateSmoothing(Vst::SampleRate sampleRate)
     slew_.setTime(kSmoothingTimeMs * 2.0, sampleRate);
 }
 
-static void readOrWriteState(IBStream* state, void* data, int64 size, bool write)
+// Only decodes: changing the oversampling factor clears filters that
+// process() may be running, so the settings are applied on the audio thread
+tresult PLUGIN_API AnalogSaturationProcessor::setState(IBStream* state)
 {
-    if (!state) {
-        return;
-    }
-    if (write) {
-        state->write(data, size);
-    } else {
-        state->read(data, size);
+    dsp::SaturationSettings settings = model32_.getSettings();
+    if (!state::read(state, settings)) {
+        return kResultFalse;
     }
-}
 
-tresult PLUGIN_API AnalogSaturationProcessor::setState(IBStream* state)
-{
-    dsp::SaturationSettings settings = model_.getSettings();
-    readOrWriteState(state, &settings, sizeof(settings), false);
-    model_.setSettings(settings);
-    drive_.setCurrent(settings.drive);
-    bias_.setCurrent(settings.bias);
-    color_.setCurrent(settings.color);
-    mix_.setCurrent(settings.mix);
-    outputTrim_.setCurrent(settings.outputTrim);
-    dynamics_.setCurrent(settings.dynamics);
-    slew_.setCurrent(settings.slew);
-    bypass_ = settings.bypass;
+    while (pendingSettingsLock_.test_and_set(std::memory_order_acquire)) {
+    }
+    pendingSettings_ = settings;
+    statePending_.store(true, std::memory_order_relaxed);
+    pendingSettingsLock_.clear(std::memory_order_release);
     return kResultOk;
 }
 
 tresult PLUGIN_API AnalogSaturationProcessor::getState(IBStream* state)
 {
-    auto settings = model_.getSettings();
+    auto settings = model32_.getSettings();
     settings.bypass = bypass_;
-    readOrWriteState(state, &settings, sizeof(settings), true);
-    return kResultOk;
+
+    // A state set but not yet applied is what the host expects back
+    while (pendingSettingsLock_.test_and_set(std::memory_order_acquire)) {
+    }
+    if (statePending_.load(std::memory_order_relaxed)) {
+        settings = pendingSettings_;
+    }
+    pendingSettingsLock_.clear(std::memory_order_release);
+
+    return state::write(state, settings) ? kResultOk : kResultFalse;
 }
 
-static float getNormalizedValue(Vst::IParamValueQueue* queue)
+void AnalogSaturationProcessor::applyPendingState()
 {
-    if (!queue) {
-        return 0.0F;
-    }
-    int32 lastIndex = queue->getPointCount() - 1;
-    if (lastIndex < 0) {
-        return 0.0F;
+    if (!statePending_.load(std::memory_order_relaxed)) {
+        return;
     }
-    int32 sampleOffset = 0;
-    double value = 0.0;
-    if (queue->getPoint(lastIndex, sampleOffset, value) == kResultTrue) {
-        return static_cast<float>(value);
+    if (pendingSettingsLock_.test_and_set(std::memory_order_acquire)) {
+        return;
     }
-    return 0.0F;
+    const dsp::SaturationSettings settings = pendingSettings_;
+    statePending_.store(false, std::memory_order_relaxed);
+    pendingSettingsLock_.clear(std::memory_order_release);
+
+    applySettings(settings);
+    drive_.setCurrent(settings.drive);
+    bias_.setCurrent(settings.bias);
+    color_.setCurrent(settings.color);
+    mix_.setCurrent(settings.mix);
+    outputTrim_.setCurrent(settings.outputTrim);
+    dynamics_.setCurrent(settings.dynamics);
+    slew_.setCurrent(settings.slew);
+    bypass_ = settings.bypass;
 }
 
 void AnalogSaturationProcessor::SmoothedValue::setTime(double timeMs, double sampleRate)
@@ -177,131 +252,198 @@ void AnalogSaturationProcessor::SmoothedValue::setTarget(float value)
     target = value;
 }
 
-float AnalogSaturationProcessor::SmoothedValue::getNext()
+void AnalogSaturationProcessor::SmoothedValue::skip(int32 numSamples)
 {
-    current += static_cast<float>((1.0 - coeff) * (target - current));
-    return current;
+    if (!isSmoothing()) {
+        return;
+    }
+    current = target + static_cast<float>(std::pow(coeff, numSamples) * (current - target));
+    if (std::fabs(target - current) < kSettleThreshold) {
+        current = target;
+    }
+}
+
+void AnalogSaturationProcessor::applyParameterChange(ParamID id, ParamValue normalized)
+{
+    const auto value = static_cast<float>(normalized);
+    switch (id) {
+        case ids::kDrive:
+            drive_.setTarget(value);
+            break;
+        case ids::kBias:
+            bias_.setTarget(value * 2.0F - 1.0F);
+            break;
+        case ids::kColor:
+            color_.setTarget(value);
+            break;
+        case ids::kMix:
+            mix_.setTarget(value);
+            break;
+        case ids::kOutputTrim:
+            outputTrim_.setTarget(-12.0F + value * 24.0F);
+            break;
+        case ids::kDynamics:
+            dynamics_.setTarget(value);
+            break;
+        case ids::kSlew:
+            slew_.setTarget(value);
+            break;
+        case ids::kQuality:
+        {
+            dsp::SaturationSettings settings = model32_.getSettings();
+            settings.quality = value;
+            applySettings(settings);
+            break;
+        }
+        case ids::kBypass:
+            bypass_ = value;
+            break;
+        default:
+            break;
+    }
 }
 
 tresult PLUGIN_API AnalogSaturationProcessor::process(ProcessData& data)
 {
-    Vst::IParameterChanges* params = data.inputParameterChanges;
-    if (params) {
-        const int32 numParams = params->getParameterCount();
+    // A new latency from a restored Quality goes out through reportLatency()
+    applyPendingState();
+
+    // One cursor per automated parameter; hosts send at most one queue per ID
+    std::array<AutomationCursor, ids::kNumParameters> cursors {};
+    int32 numCursors = 0;
+
+    if (Vst::IParameterChanges* params = data.inputParameterChanges) {
+        const int32 numParams = std::min(params->getParameterCount(), ids::kNumParameters);
         for (int32 i = 0; i < numParams; ++i) {
             auto* queue = params->getParameterData(i);
             if (!queue) {
                 continue;
             }
+            AutomationCursor cursor {queue, queue->getPointCount()};
+            if (cursor.load()) {
+                cursors[static_cast<size_t>(numCursors++)] = cursor;
+            }
+        }
+    }
 
-            ParamID pid = queue->getParameterId();
-            float value = getNormalizedValue(queue);
-            switch (pid) {
-                case ids::kDrive:
-                    drive_.setTarget(value);
-                    break;
-                case ids::kBias:
-                    bias_.setTarget(value * 2.0F - 1.0F);
-                    break;
-                case ids::kColor:
-                    color_.setTarget(value);
-                    break;
-                case ids::kMix:
-                    mix_.setTarget(value);
-                    break;
-                case ids::kOutputTrim:
-                    outputTrim_.setTarget(-12.0F + value * 24.0F);
-                    break;
-                case ids::kDynamics:
-                    dynamics_.setTarget(value);
-                    break;
-                case ids::kSlew:
-                    slew_.setTarget(value);
-                    break;
-                case ids::kQuality:
-                {
-                    dsp::SaturationSettings settings = model_.getSettings();
-                    settings.quality = value;
-                    model_.setSettings(settings);
-                    break;
-                }
-                case ids::kBypass:
-                    bypass_ = value;
-                    break;
-                default:
-                    break;
+    const bool hasAudio = data.numInputs > 0 && data.numOutputs > 0 && data.numSamples > 0;
+
+    // Split the block wherever a point lands, so every change takes effect on
+    // its own sample. Each point is read once, and there are never more
+    // sub-blocks than samples.
+    int32 position = 0;
+    while (hasAudio && position < data.numSamples) {
+        int32 end = data.numSamples;
+        for (int32 c = 0; c < numCursors; ++c) {
+            auto& cursor = cursors[static_cast<size_t>(c)];
+            while (cursor.index < cursor.numPoints && cursor.offset <= position) {
+                applyParameterChange(cursor.queue->getParameterId(), cursor.value);
+                ++cursor.index;
+                cursor.load();
+            }
+            if (cursor.index < cursor.numPoints) {
+                end = std::min(end, cursor.offset);
             }
         }
+
+        processSubBlock(data, position, end - position);
+        position = end;
     }
 
-    syncModelWithParameters();
+    // Points past the end of the block, or a parameter-only call
+    for (int32 c = 0; c < numCursors; ++c) {
+        auto& cursor = cursors[static_cast<size_t>(c)];
+        while (cursor.index < cursor.numPoints) {
+            applyParameterChange(cursor.queue->getParameterId(), cursor.value);
+            ++cursor.index;
+            cursor.load();
+        }
+    }
 
-    if (data.numInputs == 0 || data.numOutputs == 0) {
-        return kResultOk;
+    if (!hasAudio) {
+        syncModelWithParameters();
     }
 
-    const bool is64Bit = data.symbolicSampleSize == kSample64;
+    reportLatency(data.outputParameterChanges);
 
-    auto copyBypass = [&](auto** dst, auto** src) {
-        if (!dst || !src) {
-            return;
-        }
-        for (int32 ch = 0; ch < 2; ++ch) {
-            if (!dst[ch] || !src[ch]) {
-                continue;
-            }
-            if constexpr (std::is_same_v<std::remove_pointer_t<decltype(dst[ch])>, float>) {
-                std::memcpy(dst[ch], src[ch], sizeof(float) * data.numSamples);
-            } else {
-                std::memcpy(dst[ch], src[ch], sizeof(double) * data.numSamples);
-            }
-        }
-    };
+    return kResultOk;
+}
 
-    if (bypass_ >= 0.5F) {
-        if (is64Bit) {
-            copyBypass(data.outputs[0].channelBuffers64, data.inputs[0].channelBuffers64);
-        } else {
-            copyBypass(data.outputs[0].channelBuffers32, data.inputs[0].channelBuffers32);
-        }
-        return kResultOk;
+void AnalogSaturationProcessor::reportLatency(IParameterChanges* outputs)
+{
+    const uint32 latency = latencySamples_;
+    if (latency == reportedLatency_ || !outputs) {
+        return;
     }
 
-    if (is64Bit) {
-        for (auto& buf : tempIn_) {
-            buf.resize(data.numSamples);
-        }
-        for (auto& buf : tempOut_) {
-            buf.resize(data.numSamples);
+    int32 queueIndex = 0;
+    if (auto* queue = outputs->addParameterData(ids::kLatency, queueIndex)) {
+        int32 pointIndex = 0;
+        if (queue->addPoint(0, latency / ids::kMaxLatencySamples, pointIndex) == kResultTrue) {
+            reportedLatency_ = latency;
         }
+    }
+}
 
-        double** in64 = data.inputs[0].channelBuffers64;
-        double** out64 = data.outputs[0].channelBuffers64;
-        for (int32 ch = 0; ch < 2; ++ch) {
-            for (int32 i = 0; i < data.numSamples; ++i) {
-                tempIn_[ch][i] = static_cast<float>(in64[ch][i]);
-            }
-        }
+template <typename SampleType>
+void AnalogSaturationProcessor::renderSubBlock(dsp::SaturationModel<SampleType>& model, SampleType** inputs,
+                                               SampleType** outputs, int32 numChannels, int32 offset,
+                                               int32 numSamples)
+{
+    if (!inputs || !outputs) {
+        return;
+    }
 
-        float* inputChannels[2] = {tempIn_[0].data(), tempIn_[1].data()};
-        float* outputChannels[2] = {tempOut_[0].data(), tempOut_[1].data()};
-        model_.process(inputChannels, outputChannels, 2, data.numSamples);
+    std::array<SampleType*, kMaxChannels> inputChannels {};
+    std::array<SampleType*, kMaxChannels> outputChannels {};
+    numChannels = std::min(numChannels, kMaxChannels);
+    for (int32 c = 0; c < numChannels; ++c) {
+        inputChannels[static_cast<size_t>(c)] = inputs[c] ? inputs[c] + offset : nullptr;
+        outputChannels[static_cast<size_t>(c)] = outputs[c] ? outputs[c] + offset : nullptr;
+    }
 
-        for (int32 ch = 0; ch < 2; ++ch) {
-            for (int32 i = 0; i < data.numSamples; ++i) {
-                out64[ch][i] = static_cast<double>(tempOut_[ch][i]);
-            }
-        }
+    // Bypass still runs the input through the latency delay, so the host's
+    // compensation stays valid
+    if (bypass_ >= 0.5F) {
+        model.processBypassed(inputChannels.data(), outputChannels.data(), numChannels, numSamples);
     } else {
-        if (!data.inputs[0].channelBuffers32 || !data.outputs[0].channelBuffers32) {
-            return kResultOk;
-        }
-        float* inputChannels[2] = {data.inputs[0].channelBuffers32[0], data.inputs[0].channelBuffers32[1]};
-        float* outputChannels[2] = {data.outputs[0].channelBuffers32[0], data.outputs[0].channelBuffers32[1]};
-        model_.process(inputChannels, outputChannels, 2, data.numSamples);
+        model.process(inputChannels.data(), outputChannels.data(), numChannels, numSamples);
     }
+}
 
-    return kResultOk;
+void AnalogSaturationProcessor::processSubBlock(ProcessData& data, int32 offset, int32 numSamples)
+{
+    // The model derives its coefficients once per call and ramps them to the
+    // settings given, so settled parameters cost nothing per sample
+    auto isSmoothing = [this] {
+        return drive_.isSmoothing() || bias_.isSmoothing() || color_.isSmoothing() || mix_.isSmoothing()
+               || outputTrim_.isSmoothing() || dynamics_.isSmoothing() || slew_.isSmoothing();
+    };
+
+    const int32 numChannels = std::min({numChannels_, data.inputs[0].numChannels, data.outputs[0].numChannels});
+
+    for (int32 position = offset; position < offset + numSamples;) {
+        const int32 remaining = offset + numSamples - position;
+        const int32 length = isSmoothing() ? std::min(remaining, kMaxRampLength) : remaining;
+
+        drive_.skip(length);
+        bias_.skip(length);
+        color_.skip(length);
+        mix_.skip(length);
+        outputTrim_.skip(length);
+        dynamics_.skip(length);
+        slew_.skip(length);
+        syncModelWithParameters();
+
+        if (use64Bit_) {
+            renderSubBlock(model64_, data.inputs[0].channelBuffers64, data.outputs[0].channelBuffers64, numChannels,
+                           position, length);
+        } else {
+            renderSubBlock(model32_, data.inputs[0].channelBuffers32, data.outputs[0].channelBuffers32, numChannels,
+                           position, length);
+        }
+        position += length;
+    }
 }
 
 } // namespace analog
@@ -0,0 +1,233 @@
+#include "dsp/HalfbandOversampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace analog::dsp {
+namespace {
+// Dense-branch length per stage, first (steepest) stage first
+constexpr std::array<int, kMaxHalfbandStages> kStageCoefficients {32, 16, 8, 8};
+
+// Kaiser window shape, about 90 dB of stopband attenuation
+constexpr double kKaiserBeta = 9.0;
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Modified Bessel function of the first kind, order zero
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    const double halfX = 0.5 * x;
+    for (int k = 1; k < 50; ++k) {
+        term *= (halfX / k) * (halfX / k);
+        sum += term;
+        if (term < sum * 1.0e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+// Accumulates output[m] += sum_t coefficients[t] * input[m + t]
+template <typename SampleType>
+void convolve(const SampleType* coefficients, int numCoefficients, const SampleType* input, SampleType* output,
+              int numSamples)
+{
+    for (int t = 0; t < numCoefficients; ++t) {
+        const SampleType c = coefficients[t];
+        const SampleType* src = input + t;
+        for (int m = 0; m < numSamples; ++m) {
+            output[m] += c * src[m];
+        }
+    }
+}
+} // namespace
+
+template <typename SampleType>
+void HalfbandStage<SampleType>::prepare(int numCoefficients, int maxInputSamples)
+{
+    numCoefficients_ = numCoefficients;
+
+    // Kaiser-windowed sinc with its cutoff at a quarter of the upper rate.
+    // The dense branch holds the even taps of the full filter, whose centre
+    // tap sits at an odd index.
+    const int numTaps = 2 * numCoefficients - 1;
+    const double centre = 0.5 * (numTaps - 1);
+    coefficients_.resize(static_cast<size_t>(numCoefficients));
+    for (int i = 0; i < numCoefficients; ++i) {
+        const double offset = 2 * i - centre;
+        const double ratio = offset / centre;
+        const double window = besselI0(kKaiserBeta * std::sqrt(1.0 - ratio * ratio)) / besselI0(kKaiserBeta);
+        const double sinc = std::sin(0.5 * kPi * offset) / (0.5 * kPi * offset);
+        coefficients_[static_cast<size_t>(i)] = static_cast<SampleType>(sinc * window);
+    }
+
+    // Unity gain at DC for the branch; the delay branch already has it
+    const SampleType sum = std::accumulate(coefficients_.begin(), coefficients_.end(), SampleType(0));
+    for (auto& c : coefficients_) {
+        c /= sum;
+    }
+
+    const auto history = static_cast<size_t>(getDelay());
+    upBuffer_.assign(history + static_cast<size_t>(maxInputSamples), SampleType(0));
+    downEven_.assign(history + static_cast<size_t>(maxInputSamples), SampleType(0));
+    downOdd_.assign(static_cast<size_t>(numCoefficients / 2 + maxInputSamples), SampleType(0));
+    branch_.assign(static_cast<size_t>(maxInputSamples), SampleType(0));
+}
+
+template <typename SampleType>
+void HalfbandStage<SampleType>::reset()
+{
+    std::fill(upBuffer_.begin(), upBuffer_.end(), SampleType(0));
+    std::fill(downEven_.begin(), downEven_.end(), SampleType(0));
+    std::fill(downOdd_.begin(), downOdd_.end(), SampleType(0));
+}
+
+template <typename SampleType>
+void HalfbandStage<SampleType>::upsample(const SampleType* input, SampleType* output, int numSamples)
+{
+    const int history = getDelay();
+    const int half = numCoefficients_ / 2;
+    SampleType* buffer = upBuffer_.data();
+    SampleType* branch = branch_.data();
+
+    std::copy(input, input + numSamples, buffer + history);
+
+    // The coefficients are symmetric, so the dense branch needs no reversal;
+    // its gain of two for the zero-stuffing is folded into the normalisation
+    std::fill(branch, branch + numSamples, SampleType(0));
+    convolve(coefficients_.data(), numCoefficients_, buffer, branch, numSamples);
+
+    for (int m = 0; m < numSamples; ++m) {
+        output[2 * m] = branch[m];
+        output[2 * m + 1] = buffer[m + half];
+    }
+
+    std::copy(buffer + numSamples, buffer + numSamples + history, buffer);
+}
+
+template <typename SampleType>
+void HalfbandStage<SampleType>::downsample(const SampleType* input, SampleType* output, int numSamples)
+{
+    const int history = getDelay();
+    const int half = numCoefficients_ / 2;
+    SampleType* even = downEven_.data();
+    SampleType* odd = downOdd_.data();
+
+    for (int m = 0; m < numSamples; ++m) {
+        even[history + m] = input[2 * m];
+        odd[half + m] = input[2 * m + 1];
+    }
+
+    // Both branches carry half the filter's gain: the centre tap is 1/2 and
+    // the dense branch sums to one
+    std::copy(odd, odd + numSamples, output);
+    convolve(coefficients_.data(), numCoefficients_, even, output, numSamples);
+    for (int m = 0; m < numSamples; ++m) {
+        output[m] *= SampleType(0.5);
+    }
+
+    std::copy(even + numSamples, even + numSamples + history, even);
+    std::copy(odd + numSamples, odd + numSamples + half, odd);
+}
+
+template <typename SampleType>
+void HalfbandOversampler<SampleType>::prepare(int maxBlockSize)
+{
+    maxBlockSize_ = std::max(maxBlockSize, 1);
+    for (int s = 0; s < kMaxStages; ++s) {
+        stages_[static_cast<size_t>(s)].prepare(kStageCoefficients[static_cast<size_t>(s)], maxBlockSize_ << s);
+    }
+
+    const auto capacity = static_cast<size_t>(maxBlockSize_) << kMaxStages;
+    bufferA_.assign(capacity, SampleType(0));
+    bufferB_.assign(capacity, SampleType(0));
+    updateLatency();
+    reset();
+}
+
+template <typename SampleType>
+void HalfbandOversampler<SampleType>::reset()
+{
+    for (auto& stage : stages_) {
+        stage.reset();
+    }
+    alignment_.fill(SampleType(0));
+    alignmentPosition_ = 0;
+}
+
+template <typename SampleType>
+void HalfbandOversampler<SampleType>::setNumStages(int numStages)
+{
+    numStages = std::clamp(numStages, 1, kMaxStages);
+    if (numStages == numStages_) {
+        return;
+    }
+    numStages_ = numStages;
+    updateLatency();
+    reset();
+}
+
+template <typename SampleType>
+void HalfbandOversampler<SampleType>::updateLatency()
+{
+    // Each stage delays by getDelay() samples at its upper rate on the way up
+    // and again on the way down; count it all at the top rate
+    const int factor = getFactor();
+    int delay = 0;
+    for (int s = 0; s < numStages_; ++s) {
+        delay += 2 * stages_[static_cast<size_t>(s)].getDelay() * (factor >> (s + 1));
+    }
+
+    latencySamples_ = (delay + factor - 1) / factor;
+    alignmentDelay_ = latencySamples_ * factor - delay;
+}
+
+template <typename SampleType>
+SampleType* HalfbandOversampler<SampleType>::upsample(const SampleType* input, int numSamples)
+{
+    // Ping-pong between the two buffers, one stage at a time
+    const SampleType* source = input;
+    SampleType* destination = bufferA_.data();
+    int length = numSamples;
+    for (int s = 0; s < numStages_; ++s) {
+        stages_[static_cast<size_t>(s)].upsample(source, destination, length);
+        oversampled_ = destination;
+        source = destination;
+        destination = destination == bufferA_.data() ? bufferB_.data() : bufferA_.data();
+        length *= 2;
+    }
+
+    if (alignmentDelay_ > 0) {
+        for (int i = 0; i < length; ++i) {
+            alignment_[static_cast<size_t>(alignmentPosition_)] = oversampled_[i];
+            oversampled_[i] = alignment_[static_cast<size_t>((alignmentPosition_ - alignmentDelay_) & (kAlignmentSize - 1))];
+            alignmentPosition_ = (alignmentPosition_ + 1) & (kAlignmentSize - 1);
+        }
+    }
+
+    return oversampled_;
+}
+
+template <typename SampleType>
+void HalfbandOversampler<SampleType>::downsample(SampleType* output, int numSamples)
+{
+    SampleType* source = oversampled_;
+    int length = numSamples << (numStages_ - 1);
+    for (int s = numStages_ - 1; s > 0; --s) {
+        SampleType* destination = source == bufferA_.data() ? bufferB_.data() : bufferA_.data();
+        stages_[static_cast<size_t>(s)].downsample(source, destination, length);
+        source = destination;
+        length /= 2;
+    }
+    stages_[0].downsample(source, output, numSamples);
+}
+
+template class HalfbandStage<float>;
+template class HalfbandStage<double>;
+template class HalfbandOversampler<float>;
+template class HalfbandOversampler<double>;
+
+} // namespace analog::dsp
@@ -1,119 +1,385 @@
 #include "dsp/SaturationModel.h"
 
 #include <algorithm>
+#include <cstddef>
+#include <type_traits>
 
 namespace analog::dsp {
 namespace {
-constexpr float kMaxSlewHz = 300000.0F;
-constexpr float kMinSlewHz = 8000.0F;
+constexpr double kMaxSlewHz = 300000.0;
+constexpr double kMinSlewHz = 8000.0;
+
+int getOversamplingStages(float quality)
+{
+    const int step = static_cast<int>(std::lround(std::clamp(quality, 0.0F, 1.0F) * 3.0F));
+    return 1 + step;
+}
+
+// Rational approximation of tanh, within a few ulps of std::tanh over the
+// float range. Unlike the library call it is plain arithmetic, so loops over
+// lanes vectorize.
+inline float fastTanh(float x)
+{
+    x = std::min(std::max(x, -7.90531110763549805F), 7.90531110763549805F);
+    const float x2 = x * x;
+
+    float p = x2 * -2.76076847742355e-16F + 2.00018790482477e-13F;
+    p = p * x2 + -8.60467152213735e-11F;
+    p = p * x2 + 5.12229709037114e-08F;
+    p = p * x2 + 1.48572235717979e-05F;
+    p = p * x2 + 6.37261928875436e-04F;
+    p = p * x2 + 4.89352455891786e-03F;
+    p = p * x;
+
+    float q = x2 * 1.19825839466702e-06F + 1.18534705686654e-04F;
+    q = q * x2 + 2.26843463243900e-03F;
+    q = q * x2 + 4.89352518554385e-03F;
+
+    return p / q;
 }
 
-void SaturationModel::prepare(double sampleRate, int maxBlockSize)
+// Cephes-style atan: reduce to |x| <= tan(pi/8), then a short odd
+// polynomial. The reductions share one division and are selected rather than
+// branched on.
+inline float fastAtan(float x)
+{
+    const float ax = std::fabs(x);
+    const bool large = ax > 2.414213562373095F;
+    const bool medium = ax > 0.4142135623730950F;
+
+    const float numerator = large ? -1.0F : (medium ? ax - 1.0F : ax);
+    const float denominator = large ? ax : (medium ? ax + 1.0F : 1.0F);
+    const float base = large ? 1.5707963267948966F : (medium ? 0.7853981633974483F : 0.0F);
+
+    const float reduced = numerator / denominator;
+    const float z = reduced * reduced;
+    const float poly = ((8.05374449538e-2F * z - 1.38776856032e-1F) * z + 1.99777106478e-1F) * z - 3.33329491539e-1F;
+    return std::copysign(base + poly * z * reduced + reduced, x);
+}
+
+// The float model trades the last ulp for vectorizable curves; the double
+// model keeps the library functions
+template <typename SampleType>
+SampleType shaperTanh(SampleType x)
+{
+    if constexpr (std::is_same_v<SampleType, float>) {
+        return fastTanh(x);
+    } else {
+        return std::tanh(x);
+    }
+}
+
+template <typename SampleType>
+SampleType shaperAtan(SampleType x)
+{
+    if constexpr (std::is_same_v<SampleType, float>) {
+        return fastAtan(x);
+    } else {
+        return std::atan(x);
+    }
+}
+} // namespace
+
+int getOversamplingFactor(float quality)
+{
+    return 1 << getOversamplingStages(quality);
+}
+
+template <typename SampleType>
+void SaturationModel<SampleType>::prepare(double sampleRate, int maxBlockSize, int numChannels)
 {
     sampleRate_ = sampleRate;
+    maxBlockSize_ = std::max(maxBlockSize, 1);
+    numChannels_ = std::max(numChannels, 1);
+
+    const auto channels = static_cast<size_t>(numChannels_);
+    slew_.assign(channels, SampleType(0));
+    hysteresis_.assign(channels, SampleType(0));
+    oversamplers_.resize(channels);
+    dryDelay_.resize(channels);
+    for (auto& oversampler : oversamplers_) {
+        oversampler.prepare(maxBlockSize_);
+        oversampler.setNumStages(getOversamplingStages(settings_.quality));
+    }
+    driven_.assign(static_cast<size_t>(maxBlockSize_), SampleType(0));
+    wet_.assign(static_cast<size_t>(maxBlockSize_), SampleType(0));
+    target_ = makeCoefficients(settings_);
     reset();
 }
 
-void SaturationModel::reset()
+template <typename SampleType>
+void SaturationModel<SampleType>::reset()
 {
-    for (auto& s : slew_) {
-        s.prev = 0.0F;
+    std::fill(slew_.begin(), slew_.end(), SampleType(0));
+    std::fill(hysteresis_.begin(), hysteresis_.end(), SampleType(0));
+    for (auto& oversampler : oversamplers_) {
+        oversampler.reset();
     }
-    for (auto& h : hysteresis_) {
-        h.memory = 0.0F;
-    }
-    for (auto& in : lastInput_) {
-        in = 0.0F;
+    for (auto& delay : dryDelay_) {
+        delay.buffer.fill(SampleType(0));
+        delay.position = 0;
     }
+    current_ = target_;
 }
 
-void SaturationModel::setSettings(const SaturationSettings& s)
+template <typename SampleType>
+void SaturationModel<SampleType>::setSettings(const SaturationSettings& s)
 {
     settings_ = s;
-    oversampleFactor_ = (settings_.quality >= 0.5F) ? 4 : 2;
+
+    // Changing the factor clears the filters; the dry delay keeps running and
+    // only its read point moves
+    const int numStages = getOversamplingStages(settings_.quality);
+    for (auto& oversampler : oversamplers_) {
+        oversampler.setNumStages(numStages);
+    }
+
+    target_ = makeCoefficients(settings_);
 }
 
-void SaturationModel::process(float** inputs, float** outputs, int32_t numChannels, int32_t numSamples)
+template <typename SampleType>
+typename SaturationModel<SampleType>::Coefficients
+SaturationModel<SampleType>::makeCoefficients(const SaturationSettings& s) const
+{
+    const SampleType color = s.color;
+    const SampleType dynamics = s.dynamics;
+    const SampleType asym = SampleType(0.4) + color * SampleType(0.6);
+    const SampleType slewHz = SampleType(kMinSlewHz) + SampleType(kMaxSlewHz - kMinSlewHz) * SampleType(s.slew);
+    const SampleType oversampledRate = SampleType(sampleRate_) * SampleType(getOversamplingFactor(s.quality));
+
+    Coefficients c;
+    c.inputGain = (SampleType(0.6) + color * SampleType(0.8)) * std::exp2(SampleType(s.drive) * SampleType(4.5));
+    c.bias = SampleType(s.bias) * SampleType(0.8);
+    c.memoryFeedback = SampleType(0.15) + dynamics * SampleType(0.75);
+    c.evenDrive = SampleType(1) + asym * SampleType(2);
+    c.oddWeight = SampleType(1) - color;
+    c.evenWeight = asym * color;
+    c.memoryBlend = SampleType(0.35) + dynamics * SampleType(0.4);
+    c.maxStep = slewHz / oversampledRate;
+    c.mix = std::clamp(SampleType(s.mix), SampleType(0), SampleType(1));
+    c.outputGain = std::pow(SampleType(10), SampleType(s.outputTrim) / SampleType(20));
+    return c;
+}
+
+template <typename SampleType>
+typename SaturationModel<SampleType>::Coefficients
+SaturationModel<SampleType>::makeStep(const Coefficients& start, const Coefficients& end, int32_t numSamples)
+{
+    const SampleType inverse = SampleType(1) / static_cast<SampleType>(numSamples);
+    auto linear = [inverse](SampleType from, SampleType to) { return (to - from) * inverse; };
+    auto exponential = [inverse](SampleType from, SampleType to) { return std::pow(to / from, inverse); };
+
+    Coefficients step;
+    step.inputGain = exponential(start.inputGain, end.inputGain);
+    step.bias = linear(start.bias, end.bias);
+    step.memoryFeedback = linear(start.memoryFeedback, end.memoryFeedback);
+    step.evenDrive = linear(start.evenDrive, end.evenDrive);
+    step.oddWeight = linear(start.oddWeight, end.oddWeight);
+    step.evenWeight = linear(start.evenWeight, end.evenWeight);
+    step.memoryBlend = linear(start.memoryBlend, end.memoryBlend);
+    step.maxStep = linear(start.maxStep, end.maxStep);
+    step.mix = linear(start.mix, end.mix);
+    step.outputGain = exponential(start.outputGain, end.outputGain);
+    return step;
+}
+
+template <typename SampleType>
+void SaturationModel<SampleType>::advance(Coefficients& c, const Coefficients& step)
+{
+    c.inputGain *= step.inputGain;
+    c.bias += step.bias;
+    c.memoryFeedback += step.memoryFeedback;
+    c.evenDrive += step.evenDrive;
+    c.oddWeight += step.oddWeight;
+    c.evenWeight += step.evenWeight;
+    c.memoryBlend += step.memoryBlend;
+    c.maxStep += step.maxStep;
+    c.mix += step.mix;
+    c.outputGain *= step.outputGain;
+}
+
+template <typename SampleType>
+void SaturationModel<SampleType>::process(SampleType** inputs, SampleType** outputs, int32_t numChannels,
+                                          int32_t numSamples)
+{
+    if (!inputs || !outputs || numSamples <= 0) {
+        return;
+    }
+    numChannels = std::min(numChannels, static_cast<int32_t>(numChannels_));
+
+    // One ramp per block from the coefficients in use to the new settings
+    const bool ramping = !(current_ == target_);
+    const Coefficients step = ramping ? makeStep(current_, target_, numSamples) : Coefficients {};
+    const Coefficients* rampStep = ramping ? &step : nullptr;
+
+    // The scratch buffers hold one prepared block
+    Coefficients start = current_;
+    for (int32_t offset = 0; offset < numSamples; offset += maxBlockSize_) {
+        const int32_t length = std::min(numSamples - offset, static_cast<int32_t>(maxBlockSize_));
+
+        // Widest groups first: 7.1.4 runs as 8 + 4 lanes, 5.1 as 4 + 2
+        Coefficients end = start;
+        for (int32_t first = 0; first < numChannels;) {
+            const int32_t remaining = numChannels - first;
+            if (remaining >= 8) {
+                end = processGroup<8>(inputs, outputs, first, offset, length, start, rampStep);
+                first += 8;
+            } else if (remaining >= 4) {
+                end = processGroup<4>(inputs, outputs, first, offset, length, start, rampStep);
+                first += 4;
+            } else if (remaining >= 2) {
+                end = processGroup<2>(inputs, outputs, first, offset, length, start, rampStep);
+                first += 2;
+            } else {
+                end = processGroup<1>(inputs, outputs, first, offset, length, start, rampStep);
+                first += 1;
+            }
+        }
+        start = end;
+    }
+
+    current_ = target_;
+}
+
+template <typename SampleType>
+void SaturationModel<SampleType>::processBypassed(SampleType** inputs, SampleType** outputs, int32_t numChannels,
+                                                  int32_t numSamples)
 {
     if (!inputs || !outputs) {
         return;
     }
 
+    numChannels = std::min(numChannels, static_cast<int32_t>(numChannels_));
     for (int32_t c = 0; c < numChannels; ++c) {
-        float* in = inputs[c];
-        float* out = outputs[c];
+        SampleType* in = inputs[c];
+        SampleType* out = outputs[c];
         if (!in || !out) {
             continue;
         }
-
         for (int32_t i = 0; i < numSamples; ++i) {
-            float dry = in[i];
-            float wet = processSample(dry, static_cast<size_t>(c));
-            float mix = std::clamp(settings_.mix, 0.0F, 1.0F);
-            float blended = dry + (wet - dry) * mix;
-            float trim = std::pow(10.0F, settings_.outputTrim / 20.0F);
-            out[i] = blended * trim;
+            out[i] = delayDry(in[i], static_cast<size_t>(c));
         }
     }
 }
 
-float SaturationModel::processSample(float in, size_t channel)
+template <typename SampleType>
+template <int Lanes>
+void SaturationModel<SampleType>::saturate(std::array<SampleType, Lanes>& x, std::array<SampleType, Lanes>& memory,
+                                           std::array<SampleType, Lanes>& slew, const Coefficients& c)
 {
-    const float preEmphasis = 0.6F + settings_.color * 0.8F;
-    float emphasized = in * preEmphasis;
+    for (size_t l = 0; l < static_cast<size_t>(Lanes); ++l) {
+        const SampleType biased = x[l] + c.bias + memory[l] * c.memoryFeedback;
 
-    const float drive = std::exp2(settings_.drive * 4.5F);
-    emphasized *= drive;
+        const SampleType oddContribution = shaperTanh(biased);
+        const SampleType evenContribution = shaperAtan(biased * c.evenDrive);
+        const SampleType combined = oddContribution * c.oddWeight + evenContribution * c.evenWeight;
 
-    float previousInput = lastInput_[channel % lastInput_.size()];
-    float accum = 0.0F;
-    for (int f = 1; f <= oversampleFactor_; ++f) {
-        float frac = static_cast<float>(f) / static_cast<float>(oversampleFactor_);
-        float upsampled = previousInput + (emphasized - previousInput) * frac;
-        upsampled = waveshaper(upsampled, channel);
-        upsampled = slewLimit(upsampled, channel);
-        accum += upsampled;
-        previousInput = upsampled;
-    }
+        memory[l] = std::min(std::max(memory[l] + (combined - memory[l]) * c.memoryBlend, SampleType(-1)),
+                             SampleType(1));
+
+        const SampleType parallelSoftClip = combined / (SampleType(1) + std::fabs(combined));
+        const SampleType triodeEmu = SampleType(0.8) * combined + SampleType(0.2) * parallelSoftClip;
 
-    lastInput_[channel % lastInput_.size()] = emphasized;
-    const float downsampled = accum / static_cast<float>(oversampleFactor_);
-    return downsampled;
+        slew[l] += std::min(std::max(triodeEmu - slew[l], -c.maxStep), c.maxStep);
+        x[l] = slew[l];
+    }
 }
 
-float SaturationModel::waveshaper(float x, size_t channel)
+template <typename SampleType>
+template <int Lanes>
+typename SaturationModel<SampleType>::Coefficients
+SaturationModel<SampleType>::processGroup(SampleType** inputs, SampleType** outputs, int32_t firstChannel,
+                                          int32_t offset, int32_t numSamples, const Coefficients& start,
+                                          const Coefficients* step)
 {
-    auto& hyst = hysteresis_[channel % hysteresis_.size()];
-    const float biasAmount = settings_.bias * 0.8F;
-    const float dynamicMemory = hyst.memory * (0.15F + settings_.dynamics * 0.75F);
-    float biased = x + biasAmount + dynamicMemory;
+    // Each pass walks the same ramp; the coefficients for a sample are the
+    // ones reached after it, so the block ends exactly on the target
+    std::array<SampleType*, Lanes> oversampled {};
+    for (int l = 0; l < Lanes; ++l) {
+        const auto channel = static_cast<size_t>(firstChannel + l);
+        const SampleType* in = inputs[channel] ? inputs[channel] + offset : nullptr;
+
+        Coefficients c = start;
+        for (int32_t i = 0; i < numSamples; ++i) {
+            if (step) {
+                advance(c, *step);
+            }
+            driven_[static_cast<size_t>(i)] = in ? in[i] * c.inputGain : SampleType(0);
+        }
+        oversampled[static_cast<size_t>(l)] = oversamplers_[channel].upsample(driven_.data(), numSamples);
+    }
+
+    // The waveshaper and slew limiter run at the oversampled rate, each
+    // coefficient held across the oversampled samples of its base-rate
+    // sample. Every frame is gathered into one lane array, so the compiler
+    // runs the group's channels side by side in vector registers.
+    std::array<SampleType, Lanes> memory {};
+    std::array<SampleType, Lanes> slew {};
+    for (int l = 0; l < Lanes; ++l) {
+        memory[static_cast<size_t>(l)] = hysteresis_[static_cast<size_t>(firstChannel + l)];
+        slew[static_cast<size_t>(l)] = slew_[static_cast<size_t>(firstChannel + l)];
+    }
+
+    const int factor = oversamplers_[static_cast<size_t>(firstChannel)].getFactor();
+    Coefficients c = start;
+    for (int32_t i = 0; i < numSamples; ++i) {
+        if (step) {
+            advance(c, *step);
+        }
+        const ptrdiff_t frame = static_cast<ptrdiff_t>(i) * factor;
+        for (int f = 0; f < factor; ++f) {
+            std::array<SampleType, Lanes> x;
+            for (int l = 0; l < Lanes; ++l) {
+                x[static_cast<size_t>(l)] = oversampled[static_cast<size_t>(l)][frame + f];
+            }
+            saturate<Lanes>(x, memory, slew, c);
+            for (int l = 0; l < Lanes; ++l) {
+                oversampled[static_cast<size_t>(l)][frame + f] = x[static_cast<size_t>(l)];
+            }
+        }
+    }
 
-    const float asym = 0.4F + settings_.color * 0.6F;
-    const float shaper1 = std::tanh(biased);
-    const float shaper2 = std::atan(biased * (1.0F + asym * 2.0F));
+    for (int l = 0; l < Lanes; ++l) {
+        hysteresis_[static_cast<size_t>(firstChannel + l)] = memory[static_cast<size_t>(l)];
+        slew_[static_cast<size_t>(firstChannel + l)] = slew[static_cast<size_t>(l)];
+    }
 
-    const float oddContribution = shaper1;
-    const float evenContribution = shaper2 * asym;
-    float combined = oddContribution * (1.0F - settings_.color) + evenContribution * settings_.color;
+    for (int l = 0; l < Lanes; ++l) {
+        const auto channel = static_cast<size_t>(firstChannel + l);
+        oversamplers_[channel].downsample(wet_.data(), numSamples);
 
-    const float memoryBlend = 0.35F + settings_.dynamics * 0.4F;
-    hyst.memory = std::clamp(hyst.memory * (1.0F - memoryBlend) + combined * memoryBlend, -1.0F, 1.0F);
+        if (!inputs[channel] || !outputs[channel]) {
+            continue;
+        }
+        const SampleType* in = inputs[channel] + offset;
+        SampleType* out = outputs[channel] + offset;
 
-    const float parallelSoftClip = combined / (1.0F + std::fabs(combined));
-    const float triodeEmu = 0.8F * combined + 0.2F * parallelSoftClip;
+        Coefficients mixCoefficients = start;
+        for (int32_t i = 0; i < numSamples; ++i) {
+            if (step) {
+                advance(mixCoefficients, *step);
+            }
+            const SampleType dry = delayDry(in[i], channel);
+            const SampleType wet = wet_[static_cast<size_t>(i)];
+            out[i] = (dry + (wet - dry) * mixCoefficients.mix) * mixCoefficients.outputGain;
+        }
+    }
 
-    return triodeEmu;
+    return c;
 }
 
-float SaturationModel::slewLimit(float x, size_t channel)
+template <typename SampleType>
+SampleType SaturationModel<SampleType>::delayDry(SampleType x, size_t channel)
 {
-    auto& state = slew_[channel % slew_.size()];
-    const float slewHz = kMinSlewHz + (kMaxSlewHz - kMinSlewHz) * settings_.slew;
-    const float maxStep = slewHz / static_cast<float>(sampleRate_);
-    float delta = x - state.prev;
-    delta = std::clamp(delta, -maxStep, maxStep);
-    state.prev += delta;
-    return state.prev;
+    auto& delay = dryDelay_[channel];
+    constexpr int kMask = DryDelay::kSize - 1;
+    delay.buffer[static_cast<size_t>(delay.position)] = x;
+    const SampleType delayed = delay.buffer[static_cast<size_t>((delay.position - getLatencySamples()) & kMask)];
+    delay.position = (delay.position + 1) & kMask;
+    return delayed;
 }
 
+template class SaturationModel<float>;
+template class SaturationModel<double>;
+
 } // namespace analog::dsp
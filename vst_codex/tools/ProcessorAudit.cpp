@@ -0,0 +1,191 @@
+// Real-time-safety audit for AnalogSaturationProcessor::process.
+//
+//     AnalogCircuitSaturationRealtimeAudit [--blocks <n>]
+//
+// Drives the processor through 32- and 64-bit processing and a range of bus
+// arrangements, with parameter automation and varying block sizes. Any
+// allocation, lock or blocking system call made inside process() is
+// reported, and the exit code is non-zero if anything was found.
+// Arrangements or sample sizes the processor declines are skipped, as a host
+// would. Setup, activation and parameter queues are built outside the
+// audited region.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "AnalogSaturationIDs.h"
+#include "AnalogSaturationProcessor.h"
+#include "RealtimeAudit.h"
+
+#include "public.sdk/source/vst/hosting/parameterchanges.h"
+#include "public.sdk/source/vst/hosting/processdata.h"
+
+using namespace Steinberg;
+using namespace Steinberg::Vst;
+
+namespace {
+
+constexpr double kSampleRate = 48000.0;
+constexpr int32 kMaxBlockSize = 512;
+
+struct Arrangement {
+    const char* name;
+    SpeakerArrangement speakers;
+};
+
+struct Change {
+    ParamID id;
+    ParamValue value;
+};
+
+constexpr Change kParameterChanges[] = {
+    {analog::ids::kDrive, 0.9},    {analog::ids::kColor, 0.1},    {analog::ids::kQuality, 0.0},
+    {analog::ids::kBias, 0.8},     {analog::ids::kSlew, 0.2},     {analog::ids::kDynamics, 0.9},
+    {analog::ids::kMix, 0.5},      {analog::ids::kOutputTrim, 0.8}, {analog::ids::kQuality, 1.0},
+    {analog::ids::kBypass, 1.0},   {analog::ids::kBypass, 0.0},   {analog::ids::kDrive, 0.2},
+};
+
+int auditArrangement(analog::AnalogSaturationProcessor& processor, const Arrangement& arrangement,
+                     int32 sampleSize, int numBlocks)
+{
+    const std::string scenario = std::string(arrangement.name) + (sampleSize == kSample64 ? ", 64-bit" : ", 32-bit");
+
+    processor.setProcessing(false);
+    processor.setActive(false);
+
+    if (processor.canProcessSampleSize(sampleSize) != kResultTrue) {
+        std::cout << scenario << ": sample size not supported, skipped" << std::endl;
+        return 0;
+    }
+
+    SpeakerArrangement inputs = arrangement.speakers;
+    SpeakerArrangement outputs = arrangement.speakers;
+    if (processor.setBusArrangements(&inputs, 1, &outputs, 1) != kResultTrue) {
+        std::cout << scenario << ": arrangement not supported, skipped" << std::endl;
+        return 0;
+    }
+
+    ProcessSetup setup {kRealtime, sampleSize, kMaxBlockSize, kSampleRate};
+    processor.setupProcessing(setup);
+    processor.setActive(true);
+    processor.setProcessing(true);
+
+    HostProcessData data;
+    data.prepare(processor, kMaxBlockSize, sampleSize);
+
+    ParameterChanges changes(analog::ids::kNumParameters);
+    data.inputParameterChanges = &changes;
+    // Where the processor reports a latency change, as a host provides it
+    ParameterChanges outputChanges(analog::ids::kNumParameters);
+    data.outputParameterChanges = &outputChanges;
+    data.processMode = kRealtime;
+
+    const int32 numChannels = SpeakerArr::getChannelCount(arrangement.speakers);
+    int failures = 0;
+    int64 sampleIndex = 0;
+
+    for (int block = 0; block < numBlocks; ++block) {
+        const int32 numSamples = block % 5 == 4 ? 37 : kMaxBlockSize - (block % 3) * 64;
+        const bool silent = (block / 64) % 3 == 2;
+
+        changes.clearQueue();
+        outputChanges.clearQueue();
+        if (block % 8 == 7) {
+            const auto& change = kParameterChanges[(block / 8) % std::size(kParameterChanges)];
+            int32 queueIndex = 0;
+            int32 pointIndex = 0;
+            if (auto* queue = static_cast<ParameterValueQueue*>(changes.addParameterData(change.id, queueIndex))) {
+                queue->clear();
+                queue->addPoint(numSamples / 2, change.value, pointIndex);
+            }
+        }
+
+        for (int32 ch = 0; ch < numChannels; ++ch) {
+            for (int32 i = 0; i < numSamples; ++i) {
+                const double phase = 2.0 * 3.14159265358979 * 220.0 * static_cast<double>(sampleIndex + i) / kSampleRate;
+                const double value = silent ? 0.0 : 0.5 * std::sin(phase + ch);
+                if (sampleSize == kSample64) {
+                    data.inputs[0].channelBuffers64[ch][i] = value;
+                } else {
+                    data.inputs[0].channelBuffers32[ch][i] = static_cast<float>(value);
+                }
+            }
+        }
+        sampleIndex += numSamples;
+        data.numSamples = numSamples;
+
+        {
+            RealtimeAudit::ScopedAudioCallback audioCallback;
+            processor.process(data);
+        }
+
+        const auto report = RealtimeAudit::takeReport();
+        if (!report.isClean() && failures++ < 5) {
+            std::cout << scenario << ", block " << block << ":";
+            for (int kind = 0; kind < RealtimeAudit::numKinds; ++kind) {
+                if (report.counts[static_cast<size_t>(kind)] > 0) {
+                    std::cout << " " << report.counts[static_cast<size_t>(kind)] << " "
+                              << RealtimeAudit::getKindName(static_cast<RealtimeAudit::Kind>(kind));
+                }
+            }
+            std::cout << " (first: " << report.firstCall << ")" << std::endl;
+        }
+    }
+
+    data.unprepare();
+
+    std::cout << scenario << ": " << (failures == 0 ? std::string("clean") : std::to_string(failures) + " blocks failed")
+              << std::endl;
+    return failures;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int numBlocks = 1000;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument(argv[i]);
+        if (argument == "--blocks" && i + 1 < argc) {
+            numBlocks = std::max(1, std::atoi(argv[++i]));
+        } else {
+            std::cout << "Usage: AnalogCircuitSaturationRealtimeAudit [--blocks <n>]" << std::endl;
+            return argument == "--help" ? 0 : 1;
+        }
+    }
+
+    if (!RealtimeAudit::isSupported()) {
+        std::cout << "The real-time audit hooks need Linux with glibc" << std::endl;
+        return 1;
+    }
+
+    IPtr<analog::AnalogSaturationProcessor> processor = owned(new analog::AnalogSaturationProcessor());
+    if (processor->initialize(nullptr) != kResultOk) {
+        std::cout << "initialize failed" << std::endl;
+        return 1;
+    }
+
+    const Arrangement arrangements[] = {
+        {"mono", SpeakerArr::kMono},
+        {"stereo", SpeakerArr::kStereo},
+        {"5.1", SpeakerArr::k51},
+        {"7.1.4", SpeakerArr::k71_4},
+    };
+
+    int failures = 0;
+    for (const auto& arrangement : arrangements) {
+        failures += auditArrangement(*processor, arrangement, kSample32, numBlocks);
+        failures += auditArrangement(*processor, arrangement, kSample64, numBlocks);
+    }
+
+    processor->setProcessing(false);
+    processor->setActive(false);
+    processor->terminate();
+
+    return failures == 0 ? 0 : 1;
+}